@@ -13,8 +13,10 @@ typedef struct Sala {
 
 // ---------- ESTRUTURA DA PISTA (BST) ----------
 // Cada nó da árvore BST contém uma pista coletada, organizada alfabeticamente.
+// A árvore é mantida balanceada (AVL); altura é a altura da subárvore do nó.
 typedef struct PistaNode {
     char pista[100];
+    int altura;
     struct PistaNode *esquerda;
     struct PistaNode *direita;
 } PistaNode;
@@ -43,32 +45,91 @@ PistaNode* criarPistaNode(const char *pista) {
         exit(1);
     }
     strcpy(nova->pista, pista);
+    nova->altura = 1;
     nova->esquerda = NULL;
     nova->direita = NULL;
     return nova;
 }
 
+// ---------- FUNÇÕES AUXILIARES DA AVL ----------
+// Altura de uma subárvore (0 para árvore vazia).
+int alturaPista(PistaNode *no) {
+    return no == NULL ? 0 : no->altura;
+}
+
+void atualizarAltura(PistaNode *no) {
+    int he = alturaPista(no->esquerda);
+    int hd = alturaPista(no->direita);
+    no->altura = 1 + (he > hd ? he : hd);
+}
+
+PistaNode* rotacionarDireita(PistaNode *y) {
+    PistaNode *x = y->esquerda;
+    y->esquerda = x->direita;
+    x->direita = y;
+    atualizarAltura(y);
+    atualizarAltura(x);
+    return x;
+}
+
+PistaNode* rotacionarEsquerda(PistaNode *x) {
+    PistaNode *y = x->direita;
+    x->direita = y->esquerda;
+    y->esquerda = x;
+    atualizarAltura(x);
+    atualizarAltura(y);
+    return y;
+}
+
+// Reequilibra o nó depois de uma inserção em uma de suas subárvores.
+PistaNode* balancear(PistaNode *no) {
+    atualizarAltura(no);
+    int fator = alturaPista(no->esquerda) - alturaPista(no->direita);
+    if (fator > 1) {
+        if (alturaPista(no->esquerda->esquerda) < alturaPista(no->esquerda->direita))
+            no->esquerda = rotacionarEsquerda(no->esquerda);
+        return rotacionarDireita(no);
+    }
+    if (fator < -1) {
+        if (alturaPista(no->direita->direita) < alturaPista(no->direita->esquerda))
+            no->direita = rotacionarDireita(no->direita);
+        return rotacionarEsquerda(no);
+    }
+    return no;
+}
+
 // ---------- FUNÇÃO: inserirPista ----------
-// Insere uma nova pista na árvore BST em ordem alfabética.
+// Insere uma nova pista na árvore em ordem alfabética, mantendo-a balanceada.
+// Retorna a nova raiz (pode mudar após as rotações).
 PistaNode* inserirPista(PistaNode *raiz, const char *pista) {
     if (raiz == NULL) {
         return criarPistaNode(pista);
     }
-    if (strcmp(pista, raiz->pista) < 0)
+    int cmp = strcmp(pista, raiz->pista);
+    if (cmp < 0)
         raiz->esquerda = inserirPista(raiz->esquerda, pista);
-    else if (strcmp(pista, raiz->pista) > 0)
+    else if (cmp > 0)
         raiz->direita = inserirPista(raiz->direita, pista);
-    // pistas iguais são ignoradas
-    return raiz;
+    else
+        return raiz; // pistas iguais são ignoradas
+    return balancear(raiz);
 }
 
 // ---------- FUNÇÃO: exibirPistas ----------
-// Exibe todas as pistas coletadas em ordem alfabética (in-order traversal).
+// Exibe todas as pistas coletadas em ordem alfabética (in-order iterativo).
 void exibirPistas(PistaNode *raiz) {
-    if (raiz == NULL) return;
-    exibirPistas(raiz->esquerda);
-    printf("🔍 %s\n", raiz->pista);
-    exibirPistas(raiz->direita);
+    PistaNode *pilha[64]; // altura de uma AVL nunca passa de 64
+    int topo = 0;
+    PistaNode *atual = raiz;
+    while (atual != NULL || topo > 0) {
+        while (atual != NULL) {
+            pilha[topo++] = atual;
+            atual = atual->esquerda;
+        }
+        atual = pilha[--topo];
+        printf("🔍 %s\n", atual->pista);
+        atual = atual->direita;
+    }
 }
 
 // ---------- FUNÇÃO: explorarSalasComPistas ----------
@@ -2,134 +2,1086 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <malloc.h>
+#include <signal.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #define MAX_NOME 64
 #define MAX_PISTA 128
-#define HASH_SIZE 101
+#define MAX_SLOT 256   // maior slot (chave + valor) aceito pela tabela hash
+#define MAX_ALTURA_AVL 64  // altura máxima da AVL (1.44*log2(n) < 64 para qualquer n endereçável)
 
 // ---------------------- ESTRUTURAS ----------------------
 
+// Identificador de um texto internado (nome de sala, pista ou suspeito).
+// Cada texto distinto existe uma única vez no pool; estruturas guardam só o id
+// e igualdade de textos vira comparação de inteiros.
+typedef uint32_t IdTexto;
+#define TEXTO_VAZIO 0u             // id do texto "" (sala sem pista)
+#define TEXTO_NENHUM 0xFFFFFFFFu   // resultado de busca sem sucesso
+
 // Nó da árvore binária que representa uma sala da mansão.
 typedef struct Sala {
-    char nome[MAX_NOME];
-    char pista[MAX_PISTA]; // pista estática associada à sala (pode ser "")
+    IdTexto nome;
+    IdTexto pista; // pista estática associada à sala (TEXTO_VAZIO se não houver)
     struct Sala *esquerda;
     struct Sala *direita;
 } Sala;
 
 // Nó da BST que armazena pistas coletadas (ordenadas alfabeticamente).
+// A árvore é balanceada (AVL): altura guarda a altura da subárvore do nó.
 typedef struct PistaNode {
-    char pista[MAX_PISTA];
+    IdTexto pista;
+    int altura;
     struct PistaNode *esquerda;
     struct PistaNode *direita;
 } PistaNode;
 
-// Nó para tabela hash que mapeia chave string -> valor string (pista -> suspeito)
-typedef struct HashNodeStr {
-    char key[MAX_PISTA];     // pista
-    char value[MAX_NOME];    // suspeito
-    struct HashNodeStr *next;
-} HashNodeStr;
+// ---------------------- MÉTRICAS ----------------------
+
+/*
+ Instrumentação dos caminhos quentes, compilada só com -DDQ_METRICAS: sem a
+ macro, as chamadas METRICA_*() não geram código nenhum.
+ - cada thread acumula num bloco próprio, registrado na primeira medição;
+   só a dona escreve nele (leitura + escrita relaxadas, sem instrução
+   atômica de leitura-modificação-escrita), e a exportação soma os blocos.
+ - histogramas log-lineares no estilo HDR: valores até 7 têm faixa própria
+   e cada potência de 2 acima disso é dividida em 8 faixas (erro relativo
+   de no máximo 12,5%), cobrindo todo o uint64_t.
+ - ler o relógio custa dezenas de ns, então latências de operações curtas
+   (sessões do modo lote) são medidas em 1 de cada AMOSTRAGEM_LATENCIA.
+ Exportação ao fim do programa e a cada SIGUSR1:
+ - DQ_METRICAS_ARQUIVO: caminho do arquivo (regravado por inteiro via arquivo
+   temporário + rename, então quem o lê nunca vê um pela metade),
+   "-" para a saída padrão; sem a variável, vai para a saída de erro.
+ - DQ_METRICAS_FORMATO: "prometheus" (texto de exposição, padrão) ou "json".
+*/
+typedef enum {
+    METRICA_SALAS_VISITADAS,      // entradas em salas no jogo interativo
+    METRICA_MOVIMENTOS_LOTE,      // movimentos lidos no modo lote
+    METRICA_SESSOES_LOTE,
+    METRICA_PISTAS_NOVAS,
+    METRICA_PISTAS_REPETIDAS,
+    METRICA_BLOCOS_ARENA,         // blocos obtidos com malloc pelas arenas
+    METRICA_BYTES_ARENA,          // tamanho desses blocos
+    METRICA_REDIMENSIONAMENTOS,   // tabelas hash que dobraram
+    N_CONTADORES
+} ContadorMetrica;
+
+typedef enum {
+    METRICA_SONDAGENS_PISTAS,     // posições examinadas por busca em hashPistaToSuspeito
+    METRICA_ALTURA_PISTAS,        // altura da BST de pistas depois de uma inserção
+    METRICA_ENTRADA_SALA_NS,      // latência de entrar numa sala (coleta + mensagens)
+    METRICA_SESSAO_LOTE_NS,       // latência de uma sessão do modo lote (amostrada)
+    N_HISTOGRAMAS
+} HistogramaMetrica;
+
+#ifdef DQ_METRICAS
+
+#define FAIXAS_HISTOGRAMA (8 + 61 * 8)
+#define AMOSTRAGEM_LATENCIA 64   // potência de 2
+
+typedef struct {
+    _Atomic uint64_t faixas[FAIXAS_HISTOGRAMA];   // a quantidade é a soma das faixas
+    _Atomic uint64_t soma;
+} Histograma;
+
+typedef struct MetricasThread {
+    _Atomic uint64_t contadores[N_CONTADORES];
+    Histograma histogramas[N_HISTOGRAMAS];
+    unsigned amostra;   // conta as medições amostradas (só a dona usa)
+    struct MetricasThread *proxima;
+} MetricasThread;
+
+static const char *const nomesContadores[N_CONTADORES][2] = {
+    { "dq_salas_visitadas_total", "Entradas em salas no jogo interativo." },
+    { "dq_movimentos_lote_total", "Movimentos lidos no modo lote (até o 's')." },
+    { "dq_sessoes_lote_total", "Sessões jogadas no modo lote." },
+    { "dq_pistas_novas_total", "Pistas coletadas pela primeira vez na sessão." },
+    { "dq_pistas_repetidas_total", "Entradas em salas com pista já coletada." },
+    { "dq_arena_blocos_total", "Blocos obtidos com malloc pelas arenas." },
+    { "dq_arena_bytes_total", "Bytes dos blocos obtidos pelas arenas." },
+    { "dq_tabela_redimensionamentos_total", "Vezes em que uma tabela hash dobrou de tamanho." },
+};
+
+static const char *const nomesHistogramas[N_HISTOGRAMAS][2] = {
+    { "dq_sondagens_pista_suspeito", "Posições examinadas por busca em hashPistaToSuspeito." },
+    { "dq_altura_bst_pistas", "Altura da BST de pistas depois de uma inserção." },
+    { "dq_entrada_sala_ns", "Nanossegundos para entrar numa sala no jogo interativo." },
+    { "dq_sessao_lote_ns", "Nanossegundos por sessão do modo lote (1 a cada 64 sessões)." },
+};
+
+static _Thread_local MetricasThread *metricasLocais;
+static MetricasThread *todasMetricas;
+static pthread_mutex_t travaMetricas = PTHREAD_MUTEX_INITIALIZER;
+
+static MetricasThread* registrarMetricasThread(void) {
+    MetricasThread *m = (MetricasThread*) calloc(1, sizeof(MetricasThread));
+    if (!m) { perror("malloc"); exit(1); }
+    pthread_mutex_lock(&travaMetricas);
+    m->proxima = todasMetricas;
+    todasMetricas = m;
+    pthread_mutex_unlock(&travaMetricas);
+    metricasLocais = m;
+    return m;
+}
+
+static inline MetricasThread* metricasDaThread(void) {
+    return metricasLocais ? metricasLocais : registrarMetricasThread();
+}
+
+// Soma sem instrução atômica: só a thread dona escreve no contador.
+static inline void somarRelaxado(_Atomic uint64_t *c, uint64_t n) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline size_t faixaHistograma(uint64_t v) {
+    if (v < 8) return (size_t) v;
+    int msb = 63 - __builtin_clzll(v);
+    return 8 + (size_t)(msb - 3) * 8 + (size_t)((v >> (msb - 3)) & 7);
+}
+
+// Maior valor que cai na faixa i.
+static uint64_t limiteFaixa(size_t i) {
+    if (i < 8) return i;
+    int msb = (int)((i - 8) / 8) + 3;
+    uint64_t sub = (i - 8) % 8;
+    return ((8 + sub) << (msb - 3)) + ((1ull << (msb - 3)) - 1);
+}
+
+static inline void registrarHistograma(HistogramaMetrica h, uint64_t v) {
+    Histograma *x = &metricasDaThread()->histogramas[h];
+    somarRelaxado(&x->faixas[faixaHistograma(v)], 1);
+    somarRelaxado(&x->soma, v);
+}
+
+static inline uint64_t relogioNs(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000ull + (uint64_t) t.tv_nsec;
+}
+
+#define METRICA_SOMAR(contador, n) somarRelaxado(&metricasDaThread()->contadores[contador], (uint64_t)(n))
+#define METRICA_REGISTRAR(histograma, valor) registrarHistograma(histograma, (uint64_t)(valor))
+// Início da medição de uma latência; na versão amostrada, var fica 0 quando a vez não é medida.
+#define METRICA_INICIO(var) uint64_t var = relogioNs()
+#define METRICA_INICIO_AMOSTRADO(var) \
+    uint64_t var = (++metricasDaThread()->amostra & (AMOSTRAGEM_LATENCIA - 1)) == 0 ? relogioNs() : 0
+#define METRICA_DURACAO(histograma, var) do { if (var) registrarHistograma(histograma, relogioNs() - (var)); } while (0)
+
+// Soma dos blocos de todas as threads (chamada com travaMetricas).
+static void somarMetricas(uint64_t *contadores, uint64_t (*faixas)[FAIXAS_HISTOGRAMA], uint64_t *somas, uint64_t *quantidades) {
+    memset(contadores, 0, N_CONTADORES * sizeof(uint64_t));
+    memset(faixas, 0, N_HISTOGRAMAS * sizeof(*faixas));
+    memset(somas, 0, N_HISTOGRAMAS * sizeof(uint64_t));
+    for (MetricasThread *m = todasMetricas; m; m = m->proxima) {
+        for (int c = 0; c < N_CONTADORES; c++)
+            contadores[c] += atomic_load_explicit(&m->contadores[c], memory_order_relaxed);
+        for (int h = 0; h < N_HISTOGRAMAS; h++) {
+            for (size_t i = 0; i < FAIXAS_HISTOGRAMA; i++)
+                faixas[h][i] += atomic_load_explicit(&m->histogramas[h].faixas[i], memory_order_relaxed);
+            somas[h] += atomic_load_explicit(&m->histogramas[h].soma, memory_order_relaxed);
+        }
+    }
+    for (int h = 0; h < N_HISTOGRAMAS; h++) {
+        quantidades[h] = 0;
+        for (size_t i = 0; i < FAIXAS_HISTOGRAMA; i++) quantidades[h] += faixas[h][i];
+    }
+}
+
+static void escreverMetricas(FILE *f, int json) {
+    static uint64_t contadores[N_CONTADORES], faixas[N_HISTOGRAMAS][FAIXAS_HISTOGRAMA];
+    static uint64_t somas[N_HISTOGRAMAS], quantidades[N_HISTOGRAMAS];
+    somarMetricas(contadores, faixas, somas, quantidades);
+    if (json) fprintf(f, "{\"contadores\":{");
+    for (int c = 0; c < N_CONTADORES; c++) {
+        if (json) fprintf(f, "%s\"%s\":%llu", c ? "," : "", nomesContadores[c][0], (unsigned long long) contadores[c]);
+        else fprintf(f, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", nomesContadores[c][0], nomesContadores[c][1],
+                     nomesContadores[c][0], nomesContadores[c][0], (unsigned long long) contadores[c]);
+    }
+    if (json) fprintf(f, "},\"histogramas\":{");
+    for (int h = 0; h < N_HISTOGRAMAS; h++) {
+        const char *nome = nomesHistogramas[h][0];
+        if (json) fprintf(f, "%s\"%s\":{\"quantidade\":%llu,\"soma\":%llu,\"faixas\":[", h ? "," : "", nome,
+                          (unsigned long long) quantidades[h], (unsigned long long) somas[h]);
+        else fprintf(f, "# HELP %s %s\n# TYPE %s histogram\n", nome, nomesHistogramas[h][1], nome);
+        // só as faixas ocupadas: no texto de exposição as contagens são acumuladas
+        uint64_t acumulado = 0;
+        int primeira = 1;
+        for (size_t i = 0; i < FAIXAS_HISTOGRAMA; i++) {
+            if (faixas[h][i] == 0) continue;
+            acumulado += faixas[h][i];
+            if (json) fprintf(f, "%s[%llu,%llu]", primeira ? "" : ",", (unsigned long long) limiteFaixa(i), (unsigned long long) faixas[h][i]);
+            else fprintf(f, "%s_bucket{le=\"%llu\"} %llu\n", nome, (unsigned long long) limiteFaixa(i), (unsigned long long) acumulado);
+            primeira = 0;
+        }
+        if (json) fprintf(f, "]}");
+        else fprintf(f, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %llu\n%s_count %llu\n", nome, (unsigned long long) quantidades[h],
+                     nome, (unsigned long long) somas[h], nome, (unsigned long long) quantidades[h]);
+    }
+    if (json) fprintf(f, "}}\n");
+}
+
+// Exporta as métricas somadas de todas as threads para o destino configurado.
+void exportarMetricas(void) {
+    const char *arquivo = getenv("DQ_METRICAS_ARQUIVO");
+    const char *formato = getenv("DQ_METRICAS_FORMATO");
+    int json = formato && strcmp(formato, "json") == 0;
+    pthread_mutex_lock(&travaMetricas);
+    if (!arquivo || strcmp(arquivo, "-") == 0) {
+        FILE *f = arquivo ? stdout : stderr;
+        escreverMetricas(f, json);
+        fflush(f);
+    } else {
+        size_t L = strlen(arquivo);
+        char *tmp = (char*) malloc(L + 5);
+        if (!tmp) { perror("malloc"); exit(1); }
+        memcpy(tmp, arquivo, L);
+        memcpy(tmp + L, ".tmp", 5);
+        FILE *f = fopen(tmp, "w");
+        if (!f) perror(tmp);
+        else {
+            escreverMetricas(f, json);
+            if (fclose(f) != 0 || rename(tmp, arquivo) != 0) perror(arquivo);
+        }
+        free(tmp);
+    }
+    pthread_mutex_unlock(&travaMetricas);
+}
+
+// Thread que espera SIGUSR1 (bloqueado em todas as outras) e exporta a cada sinal.
+static void* esperarSinalMetricas(void *arg) {
+    sigset_t *sinais = (sigset_t*) arg;
+    int sinal;
+    while (sigwait(sinais, &sinal) == 0) exportarMetricas();
+    return NULL;
+}
+
+/*
+ iniciarMetricas():
+ - chamada no início de main, antes de qualquer outra thread: bloqueia
+   SIGUSR1 (as threads criadas depois herdam a máscara), cria a thread que o
+   atende e agenda a exportação final para a saída do programa.
+*/
+void iniciarMetricas(void) {
+    static sigset_t sinais;
+    sigemptyset(&sinais);
+    sigaddset(&sinais, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &sinais, NULL);
+    pthread_t t;
+    if (pthread_create(&t, NULL, esperarSinalMetricas, &sinais) != 0) { perror("pthread_create"); exit(1); }
+    pthread_detach(t);
+    atexit(exportarMetricas);
+}
+
+#else
+
+#define METRICA_SOMAR(contador, n) ((void) 0)
+#define METRICA_REGISTRAR(histograma, valor) ((void) 0)
+#define METRICA_INICIO(var) ((void) 0)
+#define METRICA_INICIO_AMOSTRADO(var) ((void) 0)
+#define METRICA_DURACAO(histograma, var) ((void) 0)
+
+void iniciarMetricas(void) {}
+
+#endif
+
+// ---------------------- ARENA DE MEMÓRIA ----------------------
+
+// Arena (alocador por avanço de ponteiro) com blocos encadeados.
+// Salas, nós de pista e textos internados são tirados daqui em vez de um
+// malloc por nó, e a arena inteira é devolvida de uma vez no fim do jogo,
+// sem percorrer as árvores.
+#define ARENA_BLOCO_PADRAO (64 * 1024)
+
+typedef struct BlocoArena {
+    struct BlocoArena *anterior;
+    size_t usado;
+    size_t tamanho;
+    unsigned char dados[];
+} BlocoArena;
+
+typedef struct {
+    BlocoArena *atual;
+    size_t alocacoes;   // chamadas a arenaAlocar (para estatísticas)
+    size_t blocos;      // blocos obtidos com malloc
+    size_t bytes;       // bytes entregues
+} Arena;
+
+Arena arenaSalas;    // salas do mapa
+
+// Reserva tam bytes com o alinhamento pedido (potência de 2).
+static void* arenaReservar(Arena *a, size_t tam, size_t alinhamento) {
+    BlocoArena *b = a->atual;
+    size_t inicio = 0;
+    if (b) {
+        uintptr_t p = (uintptr_t)(b->dados + b->usado);
+        inicio = b->usado + (((p + alinhamento - 1) & ~(uintptr_t)(alinhamento - 1)) - p);
+    }
+    if (!b || inicio + tam > b->tamanho) {
+        size_t tamBloco = tam + alinhamento > ARENA_BLOCO_PADRAO ? tam + alinhamento : ARENA_BLOCO_PADRAO;
+        BlocoArena *novo = (BlocoArena*) malloc(sizeof(BlocoArena) + tamBloco);
+        if (!novo) { perror("malloc"); exit(1); }
+        novo->usado = 0;
+        novo->tamanho = tamBloco;
+        if (b && tamBloco > ARENA_BLOCO_PADRAO) {
+            // bloco exclusivo: entra atrás do atual para não desperdiçar o espaço restante dele
+            novo->anterior = b->anterior;
+            b->anterior = novo;
+        } else {
+            novo->anterior = b;
+            a->atual = novo;
+        }
+        a->blocos++;
+        METRICA_SOMAR(METRICA_BLOCOS_ARENA, 1);
+        METRICA_SOMAR(METRICA_BYTES_ARENA, tamBloco);
+        b = novo;
+        uintptr_t p = (uintptr_t) b->dados;
+        inicio = ((p + alinhamento - 1) & ~(uintptr_t)(alinhamento - 1)) - p;
+    }
+    void *p = b->dados + inicio;
+    b->usado = inicio + tam;
+    a->alocacoes++;
+    a->bytes += tam;
+    return p;
+}
+
+/*
+ arenaAlocar(a, tam):
+ - retorna memória alinhada a 8 bytes, válida até arenaLiberar().
+ - pedidos maiores que o bloco padrão recebem um bloco próprio.
+*/
+void* arenaAlocar(Arena *a, size_t tam) {
+    return arenaReservar(a, tam, 8);
+}
+
+// Copia a string para a arena (sem alinhamento) e devolve a cópia.
+char* arenaCopiarTexto(Arena *a, const char *s, size_t L) {
+    char *p = (char*) arenaReservar(a, L + 1, 1);
+    memcpy(p, s, L);
+    p[L] = '\0';
+    return p;
+}
+
+// Esvazia a arena mantendo só o bloco mais recente para reaproveitar
+// (usado entre sessões do modo lote, sem ida e volta ao malloc).
+void arenaReiniciar(Arena *a) {
+    BlocoArena *b = a->atual;
+    if (!b) return;
+    BlocoArena *ant = b->anterior;
+    while (ant) {
+        BlocoArena *aux = ant->anterior;
+        free(ant);
+        ant = aux;
+    }
+    b->anterior = NULL;
+    b->usado = 0;
+    a->alocacoes = 0;
+    a->blocos = 1;
+    a->bytes = 0;
+}
+
+// Devolve todos os blocos da arena ao sistema.
+void arenaLiberar(Arena *a) {
+    BlocoArena *b = a->atual;
+    while (b) {
+        BlocoArena *ant = b->anterior;
+        free(b);
+        b = ant;
+    }
+    a->atual = NULL;
+    a->alocacoes = a->blocos = a->bytes = 0;
+}
 
-// Nó para tabela hash que mapeia suspeito -> contador de pistas (int)
-typedef struct HashNodeInt {
-    char key[MAX_NOME];      // suspeito
-    int value;               // contador
-    struct HashNodeInt *next;
-} HashNodeInt;
+// ---------------------- TABELA HASH (ENDEREÇAMENTO ABERTO) ----------------------
 
-// Tabelas hash (encadeamento)
-HashNodeStr* hashPistaToSuspeito[HASH_SIZE];
-HashNodeInt* hashSuspeitoCount[HASH_SIZE];
+// Tabela hash genérica com endereçamento aberto e sondagem linear Robin Hood.
+// Chaves de largura fixa (tamChave bytes, comparadas com memcmp, ou numa só
+// comparação de 32 bits quando a chave é um IdTexto) ficam
+// armazenadas dentro do próprio slot (sem malloc por entrada) e o hash completo
+// de cada slot é guardado em um vetor à parte, o que evita comparar chaves
+// quando os hashes já diferem.
+// O hash 0 marca slot vazio; a tabela dobra de tamanho ao passar de 7/8 de ocupação.
+// A posição ideal vem dos bits altos de hash * multiplicador, com multiplicador
+// próprio de cada tabela: copiar uma tabela para outra na ordem dos slots não
+// gera agrupamentos, porque a ordem de uma não tem relação com a da outra
+// (nem entre processos: a semente inicial vem do relógio e do pid).
+typedef struct {
+    unsigned int *hashes;      // hash completo de cada slot (0 = vazio)
+    unsigned char *slots;      // capacidade * (tamChave + tamValor) bytes
+    size_t capacidade;         // sempre potência de 2 (1 << bits)
+    unsigned int bits;
+    unsigned int multiplicador; // ímpar, sorteado por tabela
+    size_t quantidade;
+    size_t tamChave;
+    size_t tamValor;
+} TabelaHash;
+
+// Associações do mapa (chaves e valores são ids de textos internados).
+// Depois da carga do mapa é só lida, e pode ser compartilhada entre threads.
+TabelaHash hashPistaToSuspeito;   // pista (IdTexto) -> suspeito (IdTexto)
+TabelaHash pesosPistaSuspeito;    // (pista, suspeito) -> peso (float), ver inserirAssociacao()
 
 // ---------------------- FUNÇÕES AUXILIARES HASH ----------------------
 
+// Os hashes consomem 8 bytes por vez; o resto (< 8 bytes) é lido zerado à
+// direita e o tamanho entra na semente, então "a" e "a\0" não colidem.
+// Hashes só valem dentro do processo (nada em disco depende deles).
+typedef unsigned int (*FuncaoHash)(const void *dados, size_t n);
+
+static uint64_t lerResto(const unsigned char *p, size_t n) {
+    uint64_t w = 0;
+    memcpy(&w, p, n);
+    return w;
+}
+
+// Fecha os 64 bits do estado em 32, nunca 0 (0 é reservado para slot vazio).
+static unsigned int finalizarHash(uint64_t h) {
+    h ^= h >> 31;
+    h *= 0x94D049BB133111EBull;
+    unsigned int r = (unsigned int)(h >> 32);
+    return r ? r : 1;
+}
+
+// Versão portátil: multiplicação e xorshift por palavra de 8 bytes.
+static unsigned int hashBytesEscalar(const void *dados, size_t n) {
+    const unsigned char *p = (const unsigned char*) dados;
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ n, w;
+    for (; n >= 8; p += 8, n -= 8) {
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 29;
+    }
+    if (n) {
+        h = (h ^ lerResto(p, n)) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 29;
+    }
+    return finalizarHash(h);
+}
+
+#if defined(__x86_64__)
+// SSE4.2: instrução crc32 em duas cadeias independentes (16 bytes por volta),
+// que o processador executa em paralelo.
+__attribute__((target("sse4.2")))
+static unsigned int hashBytesCrc32(const void *dados, size_t n) {
+    const unsigned char *p = (const unsigned char*) dados;
+    uint64_t a = 0x9E3779B9u, b = n, w, v;
+    for (; n >= 16; p += 16, n -= 16) {
+        memcpy(&w, p, 8);
+        memcpy(&v, p + 8, 8);
+        a = _mm_crc32_u64(a, w);
+        b = _mm_crc32_u64(b, v);
+    }
+    if (n >= 8) {
+        memcpy(&w, p, 8);
+        a = _mm_crc32_u64(a, w);
+        p += 8;
+        n -= 8;
+    }
+    if (n) b = _mm_crc32_u64(b, lerResto(p, n));
+    return finalizarHash((a << 32 | b) * 0x9E3779B97F4A7C15ull);
+}
+#endif
+
+// Escolhe a implementação pela CPU em que o programa está rodando.
+static FuncaoHash escolherHash(void) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) return hashBytesCrc32;
+#endif
+    return hashBytesEscalar;
+}
+
+// Escolhida na primeira chamada; threads que chegarem juntas escolhem a mesma.
+static _Atomic(FuncaoHash) hashEscolhido = NULL;
+
+// Hash completo de n bytes (o índice é obtido pela tabela).
+unsigned int hashBytes(const void *dados, size_t n) {
+    FuncaoHash f = atomic_load_explicit(&hashEscolhido, memory_order_relaxed);
+    if (!f) {
+        f = escolherHash();
+        atomic_store_explicit(&hashEscolhido, f, memory_order_relaxed);
+    }
+    return f(dados, n);
+}
+
 unsigned int hashString(const char *s) {
-    // djb2 simplificado
-    unsigned long hash = 5381;
-    int c;
-    while ((c = *s++))
-        hash = ((hash << 5) + hash) + (unsigned char)c;
-    return (unsigned int)(hash % HASH_SIZE);
+    return hashBytes(s, strlen(s));
+}
+
+void tabelaInicializar(TabelaHash *t, size_t tamChave, size_t tamValor) {
+    static unsigned int sementes = 0;
+    if (sementes == 0) sementes = (unsigned int) time(NULL) ^ ((unsigned int) getpid() << 16);
+    if (tamChave + tamValor > MAX_SLOT) { fprintf(stderr, "slot de tabela hash grande demais\n"); exit(1); }
+    t->hashes = NULL;
+    t->slots = NULL;
+    t->capacidade = 0;
+    t->bits = 0;
+    t->multiplicador = (0x9E3779B1u + 0x6A09E667u * sementes++) | 1u;
+    t->quantidade = 0;
+    t->tamChave = tamChave;
+    t->tamValor = tamValor;
+}
+
+static unsigned char* tabelaSlot(const TabelaHash *t, size_t i) {
+    return t->slots + i * (t->tamChave + t->tamValor);
+}
+
+// Posição ideal do hash h (bits altos do produto pelo multiplicador da tabela).
+static size_t tabelaPosicao(const TabelaHash *t, unsigned int h) {
+    return (unsigned int)(h * t->multiplicador) >> (32 - t->bits);
+}
+
+// Distância do slot i até a posição ideal do hash h.
+static size_t tabelaDistancia(const TabelaHash *t, unsigned int h, size_t i) {
+    return (i - tabelaPosicao(t, h)) & (t->capacidade - 1);
+}
+
+// Posiciona (hash, slot) pela regra Robin Hood: quem está mais longe da
+// posição ideal fica com o lugar. Não verifica duplicatas.
+static unsigned char* tabelaColocar(TabelaHash *t, unsigned int h, const unsigned char *slot) {
+    size_t tam = t->tamChave + t->tamValor;
+    size_t mask = t->capacidade - 1;
+    size_t i = tabelaPosicao(t, h), dist = 0;
+    unsigned char *resultado = NULL;
+    unsigned char tmp[MAX_SLOT], atual[MAX_SLOT];
+    memcpy(atual, slot, tam);
+    while (1) {
+        if (t->hashes[i] == 0) {
+            t->hashes[i] = h;
+            memcpy(tabelaSlot(t, i), atual, tam);
+            return resultado ? resultado : tabelaSlot(t, i);
+        }
+        size_t distOcupante = tabelaDistancia(t, t->hashes[i], i);
+        if (distOcupante < dist) {
+            // troca: o novo elemento fica aqui e o ocupante segue sondando
+            unsigned int hOcupante = t->hashes[i];
+            memcpy(tmp, tabelaSlot(t, i), tam);
+            t->hashes[i] = h;
+            memcpy(tabelaSlot(t, i), atual, tam);
+            if (!resultado) resultado = tabelaSlot(t, i);
+            h = hOcupante;
+            memcpy(atual, tmp, tam);
+            dist = distOcupante;
+        }
+        i = (i + 1) & mask;
+        dist++;
+    }
+}
+
+static void tabelaRedimensionar(TabelaHash *t, size_t novaCapacidade) {
+    unsigned int *hashesAntigos = t->hashes;
+    unsigned char *slotsAntigos = t->slots;
+    size_t capAntiga = t->capacidade;
+    size_t tam = t->tamChave + t->tamValor;
+    if (capAntiga) METRICA_SOMAR(METRICA_REDIMENSIONAMENTOS, 1);
+
+    t->hashes = (unsigned int*) calloc(novaCapacidade, sizeof(unsigned int));
+    t->slots = (unsigned char*) malloc(novaCapacidade * tam);
+    if (!t->hashes || !t->slots) { perror("malloc"); exit(1); }
+    t->capacidade = novaCapacidade;
+    t->bits = 0;
+    while (((size_t)1 << t->bits) < novaCapacidade) t->bits++;
+
+    for (size_t i = 0; i < capAntiga; i++) {
+        if (hashesAntigos[i])
+            tabelaColocar(t, hashesAntigos[i], slotsAntigos + i * tam);
+    }
+    free(hashesAntigos);
+    free(slotsAntigos);
+}
+
+// Garante capacidade para n entradas sem redimensionar durante a carga.
+void tabelaReservar(TabelaHash *t, size_t n) {
+    size_t cap = t->capacidade ? t->capacidade : 16;
+    while (n * 8 > cap * 7) cap *= 2;
+    if (cap != t->capacidade) tabelaRedimensionar(t, cap);
+}
+
+// Compara o slot com a chave procurada; o significado de "chave" é de quem chama.
+typedef int (*IgualChave)(const TabelaHash *t, const unsigned char *slot, const void *chave);
+
+static int igualBytes(const TabelaHash *t, const unsigned char *slot, const void *chave) {
+    return memcmp(slot, chave, t->tamChave) == 0;
+}
+
+// Chaves de 4 bytes (ids): uma comparação inteira, sem chamar memcmp.
+static int igualChave32(const TabelaHash *t, const unsigned char *slot, const void *chave) {
+    uint32_t a, b;
+    (void) t;
+    memcpy(&a, slot, sizeof(a));
+    memcpy(&b, chave, sizeof(b));
+    return a == b;
+}
+
+static IgualChave igualdadeDe(const TabelaHash *t) {
+    return t->tamChave == sizeof(uint32_t) ? igualChave32 : igualBytes;
+}
+
+/*
+ tabelaProcurar(t, h, igual, chave):
+ - retorna o slot cuja chave satisfaz igual(), ou NULL.
+ - a sondagem para assim que encontra um slot mais próximo da posição ideal
+   do que a chave procurada estaria (invariante Robin Hood).
+*/
+static unsigned char* tabelaProcurar(const TabelaHash *t, unsigned int h, IgualChave igual, const void *chave) {
+    if (t->quantidade == 0) return NULL;
+    size_t mask = t->capacidade - 1;
+    size_t i = tabelaPosicao(t, h), dist = 0;
+    while (t->hashes[i] != 0 && tabelaDistancia(t, t->hashes[i], i) >= dist) {
+        if (t->hashes[i] == h && igual(t, tabelaSlot(t, i), chave)) {
+            if (t == &hashPistaToSuspeito) METRICA_REGISTRAR(METRICA_SONDAGENS_PISTAS, dist + 1);
+            return tabelaSlot(t, i);
+        }
+        i = (i + 1) & mask;
+        dist++;
+    }
+    if (t == &hashPistaToSuspeito) METRICA_REGISTRAR(METRICA_SONDAGENS_PISTAS, dist + 1);
+    return NULL;
+}
+
+// Acrescenta um slot novo (chave ainda ausente), crescendo a tabela se preciso.
+static unsigned char* tabelaAcrescentar(TabelaHash *t, unsigned int h, const unsigned char *slot) {
+    if ((t->quantidade + 1) * 8 > t->capacidade * 7)
+        tabelaRedimensionar(t, t->capacidade ? t->capacidade * 2 : 16);
+    t->quantidade++;
+    return tabelaColocar(t, h, slot);
+}
+
+/*
+ tabelaBuscar(t, chave):
+ - chave aponta para tamChave bytes.
+ - retorna ponteiro para o valor associado à chave, ou NULL se não existir.
+*/
+void* tabelaBuscar(const TabelaHash *t, const void *chave) {
+    unsigned char *slot = tabelaProcurar(t, hashBytes(chave, t->tamChave), igualdadeDe(t), chave);
+    return slot ? slot + t->tamChave : NULL;
+}
+
+/*
+ tabelaInserir(t, chave, novo):
+ - retorna ponteiro para o valor da chave; se ela ainda não existir, cria a
+   entrada com valor zerado.
+ - novo (opcional) recebe 1 se a entrada foi criada, 0 se já existia.
+*/
+void* tabelaInserir(TabelaHash *t, const void *chave, int *novo) {
+    unsigned int h = hashBytes(chave, t->tamChave);
+    unsigned char *slot = tabelaProcurar(t, h, igualdadeDe(t), chave);
+    if (novo) *novo = (slot == NULL);
+    if (slot) return slot + t->tamChave;
+    unsigned char buf[MAX_SLOT];
+    memcpy(buf, chave, t->tamChave);
+    memset(buf + t->tamChave, 0, t->tamValor);
+    return tabelaAcrescentar(t, h, buf) + t->tamChave;
+}
+
+// Remove todas as entradas mantendo a capacidade alocada.
+void tabelaLimpar(TabelaHash *t) {
+    if (t->capacidade) memset(t->hashes, 0, t->capacidade * sizeof(unsigned int));
+    t->quantidade = 0;
+}
+
+void tabelaLiberar(TabelaHash *t) {
+    free(t->hashes);
+    free(t->slots);
+    t->hashes = NULL;
+    t->slots = NULL;
+    t->capacidade = 0;
+    t->quantidade = 0;
+    t->bits = 0;
+}
+
+// ---------------------- POOL DE TEXTOS INTERNADOS ----------------------
+
+// Cada texto distinto é copiado uma vez para a arena do pool e recebe um id
+// sequencial. O índice é uma TabelaHash cujos slots guardam só o id (4 bytes):
+// a comparação de chaves consulta o texto pelo id, olhando primeiro o tamanho.
+typedef struct {
+    TabelaHash indice;      // hash do texto -> IdTexto
+    const char **textos;    // IdTexto -> texto (ponteiros estáveis)
+    uint32_t *tamanhos;     // IdTexto -> strlen do texto
+    size_t quantidade;
+    size_t capacidade;
+    Arena arena;
+} PoolTextos;
+
+PoolTextos textosInternos;
+
+// Chave das buscas no índice: o texto com o tamanho já medido.
+typedef struct {
+    const char *texto;
+    size_t tam;
+} TextoProcurado;
+
+static int igualTexto(const TabelaHash *t, const unsigned char *slot, const void *chave) {
+    const TextoProcurado *k = (const TextoProcurado*) chave;
+    IdTexto id;
+    (void) t;
+    memcpy(&id, slot, sizeof(id));
+    return textosInternos.tamanhos[id] == k->tam && memcmp(textosInternos.textos[id], k->texto, k->tam) == 0;
+}
+
+// Texto de um id (válido até liberarTextos()).
+const char* textoDe(IdTexto id) {
+    return textosInternos.textos[id];
+}
+
+// Id de um texto já internado, ou TEXTO_NENHUM (não insere nada).
+IdTexto procurarTexto(const char *s) {
+    TextoProcurado k = { s, strlen(s) };
+    unsigned char *slot = tabelaProcurar(&textosInternos.indice, hashBytes(s, k.tam), igualTexto, &k);
+    if (!slot) return TEXTO_NENHUM;
+    IdTexto id;
+    memcpy(&id, slot, sizeof(id));
+    return id;
+}
+
+/*
+ internarTexto(s):
+ - retorna o id do texto, copiando-o para o pool na primeira vez que aparece.
+ - o pool é inicializado sob demanda com "" no id TEXTO_VAZIO.
+*/
+IdTexto internarTexto(const char *s) {
+    PoolTextos *p = &textosInternos;
+    if (p->quantidade == 0 && s[0] != '\0') internarTexto("");
+    size_t L = strlen(s);
+    TextoProcurado k = { s, L };
+    unsigned int h = hashBytes(s, L);
+    unsigned char *slot = tabelaProcurar(&p->indice, h, igualTexto, &k);
+    IdTexto id;
+    if (slot) {
+        memcpy(&id, slot, sizeof(id));
+        return id;
+    }
+    if (p->quantidade == p->capacidade) {
+        p->capacidade = p->capacidade ? p->capacidade * 2 : 1024;
+        p->textos = (const char**) realloc(p->textos, p->capacidade * sizeof(const char*));
+        p->tamanhos = (uint32_t*) realloc(p->tamanhos, p->capacidade * sizeof(uint32_t));
+        if (!p->textos || !p->tamanhos) { perror("malloc"); exit(1); }
+    }
+    if (p->indice.tamChave == 0) tabelaInicializar(&p->indice, sizeof(IdTexto), 0);
+    id = (IdTexto) p->quantidade++;
+    p->textos[id] = arenaCopiarTexto(&p->arena, s, L);
+    p->tamanhos[id] = (uint32_t) L;
+    tabelaAcrescentar(&p->indice, h, (const unsigned char*) &id);
+    return id;
+}
+
+void liberarTextos() {
+    tabelaLiberar(&textosInternos.indice);
+    free(textosInternos.textos);
+    free(textosInternos.tamanhos);
+    arenaLiberar(&textosInternos.arena);
+    memset(&textosInternos, 0, sizeof(textosInternos));
+}
+
+// ---------------------- SESSÃO DE INVESTIGAÇÃO ----------------------
+
+// Entrada do ranking de suspeitos da sessão.
+typedef struct {
+    IdTexto suspeito;
+    int contador;
+} EntradaRanking;
+
+// Estado de uma investigação: tudo o que muda durante a exploração.
+// O mapa, o pool de textos e hashPistaToSuspeito são imutáveis depois da
+// carga, então várias sessões podem rodar ao mesmo tempo em threads
+// diferentes, cada uma com a sua Sessao.
+// Os contadores ficam num heap de máximo indexado (ranking) mantido a cada
+// incremento: o líder é ranking[0] e a tabela leva o suspeito à sua posição.
+// As pistas coletadas são um bitset sobre os ids densos do catálogo de pistas
+// do mapa; a AVL em ordem alfabética só é montada quando alguém a pede
+// (pistasOrdenadas()).
+// As pontuações ponderadas ficam num vetor indexado pelo id denso do suspeito
+// (ver MATRIZ DE EVIDÊNCIAS), dividido em blocos de PONTOS_POR_BLOCO (uma
+// linha de cache): só os blocos tocados são zerados ao reiniciar e percorridos
+// no veredito.
+#define PONTOS_POR_BLOCO 16
+
+typedef struct {
+    uint64_t *coletadas;       // bitset: id denso da pista -> coletada
+    uint32_t *palavrasUsadas;  // palavras de coletadas que já não são zero
+    size_t nPalavras;          // palavras alocadas (coletadas e palavrasUsadas)
+    size_t nUsadas;
+    size_t nColetadas;         // bits ligados
+    PistaNode *raizPistas;     // visão ordenada das pistas (AVL), montada sob demanda
+    int visaoAtual;            // raizPistas corresponde ao bitset
+    TabelaHash contadores;     // suspeito (IdTexto) -> posição no ranking (uint32_t)
+    EntradaRanking *ranking;   // heap: nenhum filho passa à frente do pai
+    size_t nRanking;
+    size_t capRanking;
+    float *pontos;             // id denso do suspeito -> soma dos pesos das pistas coletadas
+    uint64_t *blocosTocados;   // bitset: bloco de pontos -> já recebeu algum peso
+    uint32_t *blocosUsados;    // blocos tocados, na ordem em que foram tocados
+    size_t nPontos;            // pontos alocados (múltiplo de PONTOS_POR_BLOCO)
+    size_t nBlocosUsados;
+    Arena arena;               // nós da visão ordenada
+} Sessao;
+
+// Sessão do jogo interativo (usada pelas funções que recebem strings)
+Sessao sessaoJogo;
+
+void iniciarSessao(Sessao *s) {
+    s->coletadas = NULL;
+    s->palavrasUsadas = NULL;
+    s->nPalavras = s->nUsadas = s->nColetadas = 0;
+    s->raizPistas = NULL;
+    s->visaoAtual = 1;
+    tabelaInicializar(&s->contadores, sizeof(IdTexto), sizeof(uint32_t));
+    s->ranking = NULL;
+    s->nRanking = s->capRanking = 0;
+    s->pontos = NULL;
+    s->blocosTocados = NULL;
+    s->blocosUsados = NULL;
+    s->nPontos = s->nBlocosUsados = 0;
+    memset(&s->arena, 0, sizeof(s->arena));
+}
+
+// Descarta pistas coletadas, contadores e pontos, mantendo a memória para a
+// próxima sessão. Só as palavras do bitset e os blocos de pontos que chegaram
+// a ser usados são zerados.
+void reiniciarSessao(Sessao *s) {
+    for (size_t i = 0; i < s->nUsadas; i++) s->coletadas[s->palavrasUsadas[i]] = 0;
+    for (size_t i = 0; i < s->nBlocosUsados; i++) {
+        uint32_t b = s->blocosUsados[i];
+        memset(s->pontos + (size_t) b * PONTOS_POR_BLOCO, 0, PONTOS_POR_BLOCO * sizeof(float));
+        s->blocosTocados[b / 64] = 0;
+    }
+    s->nBlocosUsados = 0;
+    s->nUsadas = s->nColetadas = 0;
+    s->raizPistas = NULL;
+    s->visaoAtual = 1;
+    arenaReiniciar(&s->arena);
+    tabelaLimpar(&s->contadores);
+    s->nRanking = 0;
+}
+
+void liberarSessao(Sessao *s) {
+    free(s->coletadas);
+    free(s->palavrasUsadas);
+    s->coletadas = NULL;
+    s->palavrasUsadas = NULL;
+    s->nPalavras = s->nUsadas = s->nColetadas = 0;
+    s->raizPistas = NULL;
+    s->visaoAtual = 1;
+    arenaLiberar(&s->arena);
+    tabelaLiberar(&s->contadores);
+    free(s->ranking);
+    s->ranking = NULL;
+    s->nRanking = s->capRanking = 0;
+    free(s->pontos);
+    free(s->blocosTocados);
+    free(s->blocosUsados);
+    s->pontos = NULL;
+    s->blocosTocados = NULL;
+    s->blocosUsados = NULL;
+    s->nPontos = s->nBlocosUsados = 0;
 }
 
+// ---------------------- ASSOCIAÇÕES PISTA -> SUSPEITO ----------------------
+
 // Insere associação pista -> suspeito na tabela hash.
 // Função exigida: inserirNaHash()
 /*
  inserirNaHash(key, suspect):
  - key: string da pista
  - suspect: string do suspeito
- - insere na tabela hash hashPistaToSuspeito.
+ - insere na tabela hash hashPistaToSuspeito (ambos os textos são internados).
  - sobrescreve se a chave já existir.
 */
 void inserirNaHash(const char *key, const char *suspect) {
-    unsigned int idx = hashString(key);
-    HashNodeStr *cur = hashPistaToSuspeito[idx];
-    while (cur) {
-        if (strcmp(cur->key, key) == 0) {
-            // sobrescreve o suspeito caso já exista
-            strncpy(cur->value, suspect, MAX_NOME-1);
-            cur->value[MAX_NOME-1] = '\0';
-            return;
-        }
-        cur = cur->next;
-    }
-    // criar novo nó
-    HashNodeStr *novo = (HashNodeStr*) malloc(sizeof(HashNodeStr));
-    if (!novo) { perror("malloc"); exit(1); }
-    strncpy(novo->key, key, MAX_PISTA-1); novo->key[MAX_PISTA-1] = '\0';
-    strncpy(novo->value, suspect, MAX_NOME-1); novo->value[MAX_NOME-1] = '\0';
-    novo->next = hashPistaToSuspeito[idx];
-    hashPistaToSuspeito[idx] = novo;
+    IdTexto pista = internarTexto(key);
+    IdTexto *valor = (IdTexto*) tabelaInserir(&hashPistaToSuspeito, &pista, NULL);
+    *valor = internarTexto(suspect); // sobrescreve o suspeito caso já exista
+}
+
+// Suspeito associado à pista (por id), ou TEXTO_NENHUM.
+IdTexto encontrarSuspeitoId(IdTexto pista) {
+    IdTexto *valor = (IdTexto*) tabelaBuscar(&hashPistaToSuspeito, &pista);
+    return valor ? *valor : TEXTO_NENHUM;
 }
 
 // Busca suspeito pela pista. Retorna NULL se não encontrada.
 // Função exigida: encontrarSuspeito()
 /*
- encontrarSuspeito(pista) -> retorna ponteiro para string do suspeito (static) ou NULL.
+ encontrarSuspeito(pista) -> retorna o nome do suspeito (texto internado, estável) ou NULL.
 */
 const char* encontrarSuspeito(const char *pista) {
-    unsigned int idx = hashString(pista);
-    HashNodeStr *cur = hashPistaToSuspeito[idx];
-    while (cur) {
-        if (strcmp(cur->key, pista) == 0)
-            return cur->value;
-        cur = cur->next;
+    IdTexto p = procurarTexto(pista);
+    IdTexto s = p == TEXTO_NENHUM ? TEXTO_NENHUM : encontrarSuspeitoId(p);
+    return s == TEXTO_NENHUM ? NULL : textoDe(s);
+}
+
+/*
+ inserirAssociacao(pista, suspeito, peso):
+ - faz a pista pesar sobre mais um suspeito, além do principal de
+   inserirNaHash() (que vale peso 1). Peso negativo é evidência a favor.
+ - sobrescreve o peso se o par já existir; um peso dado ao próprio suspeito
+   principal substitui o 1.
+ - os pesos entram na pontuação das sessões (ver MATRIZ DE EVIDÊNCIAS); os
+   contadores de pistas continuam contando só o suspeito principal.
+*/
+void inserirAssociacaoId(IdTexto pista, IdTexto suspeito, float peso) {
+    IdTexto par[2] = { pista, suspeito };
+    float *valor = (float*) tabelaInserir(&pesosPistaSuspeito, par, NULL);
+    *valor = peso;
+}
+
+void inserirAssociacao(const char *pista, const char *suspeito, float peso) {
+    inserirAssociacaoId(internarTexto(pista), internarTexto(suspeito), peso);
+}
+
+// Peso da pista sobre o suspeito: o de inserirAssociacao(), 1 para o
+// suspeito principal ou 0 se a pista não cita o suspeito.
+float pesoAssociacao(IdTexto pista, IdTexto suspeito) {
+    IdTexto par[2] = { pista, suspeito };
+    float *peso = (float*) tabelaBuscar(&pesosPistaSuspeito, par);
+    if (peso) return *peso;
+    return encontrarSuspeitoId(pista) == suspeito && suspeito != TEXTO_NENHUM ? 1.0f : 0.0f;
+}
+
+// Ordem do ranking: mais pistas primeiro; no empate, o suspeito internado antes.
+static int rankingAntes(const EntradaRanking *a, const EntradaRanking *b) {
+    return a->contador > b->contador || (a->contador == b->contador && a->suspeito < b->suspeito);
+}
+
+// Coloca a entrada e na posição i do ranking e atualiza o índice.
+static void rankingColocar(Sessao *s, size_t i, EntradaRanking e) {
+    s->ranking[i] = e;
+    uint32_t *pos = (uint32_t*) tabelaBuscar(&s->contadores, &e.suspeito);
+    *pos = (uint32_t) i;
+}
+
+// Restaura o heap a partir da posição i (a entrada pode ter subido ou descido).
+static void rankingAjustar(Sessao *s, size_t i) {
+    size_t inicio = i;
+    EntradaRanking e = s->ranking[i];
+    while (i > 0 && rankingAntes(&e, &s->ranking[(i - 1) / 2])) {
+        rankingColocar(s, i, s->ranking[(i - 1) / 2]);
+        i = (i - 1) / 2;
     }
-    return NULL;
+    for (;;) {
+        size_t f = 2 * i + 1;
+        if (f >= s->nRanking) break;
+        if (f + 1 < s->nRanking && rankingAntes(&s->ranking[f + 1], &s->ranking[f])) f++;
+        if (!rankingAntes(&s->ranking[f], &e)) break;
+        rankingColocar(s, i, s->ranking[f]);
+        i = f;
+    }
+    if (i != inicio) rankingColocar(s, i, e);  // se não se moveu, o índice já aponta para i
+}
+
+/*
+ incrementarContadorSuspeitoId(s, suspeito, incremento):
+ - soma incremento ao contador do suspeito (criando-o com 0) e reposiciona
+   a entrada no ranking: O(log n) trocas, cada uma atualizando o índice.
+*/
+void incrementarContadorSuspeitoId(Sessao *s, IdTexto suspeito, int incremento) {
+    int novo;
+    uint32_t *pos = (uint32_t*) tabelaInserir(&s->contadores, &suspeito, &novo);
+    size_t i;
+    if (novo) {
+        if (s->nRanking == s->capRanking) {
+            s->capRanking = s->capRanking ? s->capRanking * 2 : 64;
+            s->ranking = (EntradaRanking*) realloc(s->ranking, s->capRanking * sizeof(EntradaRanking));
+            if (!s->ranking) { perror("malloc"); exit(1); }
+        }
+        i = s->nRanking++;
+        *pos = (uint32_t) i;
+        s->ranking[i].suspeito = suspeito;
+        s->ranking[i].contador = 0;
+    } else {
+        i = *pos;
+    }
+    s->ranking[i].contador += incremento;
+    rankingAjustar(s, i);
 }
 
-// Insere ou atualiza contador do suspeito na tabela hash de contagem.
+// Insere ou atualiza contador do suspeito na tabela hash de contagem (sessão do jogo).
 // Se não existir, insere com valor 1 (ou incremento fornecido).
 void incrementarContadorSuspeito(const char *suspeito, int incremento) {
-    unsigned int idx = hashString(suspeito);
-    HashNodeInt *cur = hashSuspeitoCount[idx];
-    while (cur) {
-        if (strcmp(cur->key, suspeito) == 0) {
-            cur->value += incremento;
-            return;
+    incrementarContadorSuspeitoId(&sessaoJogo, internarTexto(suspeito), incremento);
+}
+
+int buscarContadorSuspeitoId(const Sessao *s, IdTexto suspeito) {
+    uint32_t *pos = (uint32_t*) tabelaBuscar(&s->contadores, &suspeito);
+    return pos ? s->ranking[*pos].contador : 0;
+}
+
+// Suspeito mais citado da sessão (TEXTO_NENHUM se nenhum). O(1).
+IdTexto suspeitoLider(const Sessao *s, int *contador) {
+    if (s->nRanking == 0) {
+        if (contador) *contador = 0;
+        return TEXTO_NENHUM;
+    }
+    if (contador) *contador = s->ranking[0].contador;
+    return s->ranking[0].suspeito;
+}
+
+// Fronteira de topSuspeitos(): heap de posições do ranking, na mesma ordem.
+static void fronteiraSubir(const Sessao *s, uint32_t *f, size_t j) {
+    while (j > 0 && rankingAntes(&s->ranking[f[j]], &s->ranking[f[(j - 1) / 2]])) {
+        uint32_t t = f[j]; f[j] = f[(j - 1) / 2]; f[(j - 1) / 2] = t;
+        j = (j - 1) / 2;
+    }
+}
+
+static void fronteiraDescer(const Sessao *s, uint32_t *f, size_t n, size_t j) {
+    for (;;) {
+        size_t c = 2 * j + 1;
+        if (c >= n) break;
+        if (c + 1 < n && rankingAntes(&s->ranking[f[c + 1]], &s->ranking[f[c]])) c++;
+        if (!rankingAntes(&s->ranking[f[c]], &s->ranking[f[j]])) break;
+        uint32_t t = f[j]; f[j] = f[c]; f[c] = t;
+        j = c;
+    }
+}
+
+/*
+ topSuspeitos(s, saida, k):
+ - copia para saida os até k suspeitos mais citados, em ordem.
+ - só visita o topo do ranking: a cada passo retira o melhor candidato da
+   fronteira e acrescenta seus dois filhos no heap (fronteira <= k + 1).
+   O(k log k), independente do número de suspeitos.
+ - retorna quantos foram copiados.
+*/
+size_t topSuspeitos(const Sessao *s, EntradaRanking *saida, size_t k) {
+    if (k > s->nRanking) k = s->nRanking;
+    if (k == 0) return 0;
+    uint32_t *fronteira = (uint32_t*) malloc((k + 1) * sizeof(uint32_t));
+    if (!fronteira) { perror("malloc"); exit(1); }
+    size_t n = 0;
+    fronteira[n++] = 0;
+    for (size_t c = 0; c < k; c++) {
+        uint32_t melhor = fronteira[0];
+        saida[c] = s->ranking[melhor];
+        fronteira[0] = fronteira[--n];
+        fronteiraDescer(s, fronteira, n, 0);
+        for (size_t f = 2 * (size_t) melhor + 1; f <= 2 * (size_t) melhor + 2 && f < s->nRanking; f++) {
+            fronteira[n++] = (uint32_t) f;
+            fronteiraSubir(s, fronteira, n - 1);
         }
-        cur = cur->next;
     }
-    // criar novo
-    HashNodeInt *novo = (HashNodeInt*) malloc(sizeof(HashNodeInt));
-    if (!novo) { perror("malloc"); exit(1); }
-    strncpy(novo->key, suspeito, MAX_NOME-1); novo->key[MAX_NOME-1] = '\0';
-    novo->value = incremento;
-    novo->next = hashSuspeitoCount[idx];
-    hashSuspeitoCount[idx] = novo;
+    free(fronteira);
+    return k;
 }
 
-// Busca contador do suspeito (0 se não existir)
+// Busca contador do suspeito na sessão do jogo (0 se não existir)
 int buscarContadorSuspeito(const char *suspeito) {
-    unsigned int idx = hashString(suspeito);
-    HashNodeInt *cur = hashSuspeitoCount[idx];
-    while (cur) {
-        if (strcmp(cur->key, suspeito) == 0)
-            return cur->value;
-        cur = cur->next;
-    }
-    return 0;
+    IdTexto id = procurarTexto(suspeito);
+    return id == TEXTO_NENHUM ? 0 : buscarContadorSuspeitoId(&sessaoJogo, id);
 }
 
 // ---------------------- CRIAÇÃO DE SALAS ----------------------
@@ -140,129 +1092,2588 @@ int buscarContadorSuspeito(const char *suspeito) {
  criarSala(nome, pista):
  - nome: identificador do cômodo
  - pista: string da pista ("" se não houver)
- - retorna ponteiro para Sala alocada dinamicamente.
+ - retorna ponteiro para Sala alocada na arena de salas (liberada de uma vez no fim).
+ - nome e pista são internados; a sala guarda apenas os ids.
 */
 Sala* criarSala(const char *nome, const char *pista) {
-    Sala *s = (Sala*) malloc(sizeof(Sala));
-    if (!s) { perror("malloc"); exit(1); }
-    strncpy(s->nome, nome, MAX_NOME-1); s->nome[MAX_NOME-1] = '\0';
-    strncpy(s->pista, pista, MAX_PISTA-1); s->pista[MAX_PISTA-1] = '\0';
+    Sala *s = (Sala*) arenaAlocar(&arenaSalas, sizeof(Sala));
+    s->nome = internarTexto(nome);
+    s->pista = internarTexto(pista);
     s->esquerda = s->direita = NULL;
     return s;
 }
 
-// ---------------------- BST DE PISTAS ----------------------
-
-// Cria nó de pista
-PistaNode* criarPistaNode(const char *pista) {
-    PistaNode *p = (PistaNode*) malloc(sizeof(PistaNode));
-    if (!p) { perror("malloc"); exit(1); }
-    strncpy(p->pista, pista, MAX_PISTA-1); p->pista[MAX_PISTA-1] = '\0';
-    p->esquerda = p->direita = NULL;
-    return p;
-}
+// ---------------------- CARREGAMENTO DE MAPAS ----------------------
 
-// Insere nova pista na BST (alfabética).
-// Função exigida: inserirPista() / adicionarPista()
 /*
- inserirPista(raiz, pista, coletadaFlag):
- - raiz: ponteiro para raiz atual da BST.
- - pista: string da pista a inserir.
- - coletadaFlag (ponteiro int): se >0, será incrementado quando pista inserida (para contar quantas pistas novas foram inseridas).
- - retorna nova raiz.
- - Não insere duplicatas (strings idênticas).
+ Formatos de mapa aceitos por carregarMansao():
+
+ Texto (para autoria), uma declaração por linha, '#' inicia comentário:
+   sala <indice> <esquerda> <direita> <nome>|<pista>
+   porta <origem> <destino> <nome da saída>
+   assoc <pista>|<suspeito>
+   assoc <pista>|<suspeito>|<peso>
+ - indice: 0..n-1, a sala 0 é a entrada; esquerda/direita são índices ou -1.
+ - porta: saída extra, de mão única, além de esquerda/direita (escadas,
+   passagens, portas que voltam para salas já visitadas); a volta é outra porta.
+ - assoc sem peso dá o suspeito principal da pista (o de inserirNaHash(), peso 1);
+   com peso, a pista passa a pesar também sobre esse suspeito (inserirAssociacao()).
+   Uma pista pode citar vários suspeitos: um segundo assoc sem peso para a
+   mesma pista acrescenta o suspeito com peso 1 em vez de trocar o principal.
+ - nome, pista e suspeito não podem conter '|' nem quebra de linha; pista pode ser vazia.
+
+ Binário (.dqm), pensado para mmap: cabeçalho fixo, tabela com o deslocamento
+ de cada texto distinto, vetores de registros de tamanho fixo e o bloco de
+ texto com strings terminadas em '\0'. Registros referenciam textos pelo
+ índice na tabela e salas por índice, então nenhum campo precisa ser
+ interpretado; cada texto é internado uma única vez na carga.
+ A versão 3 acrescenta as portas (nPortas no cabeçalho e um vetor de
+ PortaDisco depois das associações); a versão 4, as associações ponderadas
+ (nPesos e um vetor de PesoDisco depois das portas). Arquivos das versões 2 e
+ 3 continuam sendo lidos.
 */
-PistaNode* inserirPista(PistaNode *raiz, const char *pista, int *coletadaFlag) {
-    if (raiz == NULL) {
-        if (coletadaFlag) *coletadaFlag = 1;
-        return criarPistaNode(pista);
+#define MAPA_MAGICO "DQM4"
+#define MAPA_MAGICO_V3 "DQM3"   // sem pesos; só leitura
+#define MAPA_MAGICO_V2 "DQM2"   // sem portas nem pesos; só leitura
+#define MAPA_SEM_SALA 0xFFFFFFFFu
+
+typedef struct {
+    char magico[4];
+    uint32_t nSalas;
+    uint32_t nAssoc;
+    uint32_t nTextos;
+    uint32_t tamTexto;
+    uint32_t nPortas;    // ausente na versão 2
+    uint32_t nPesos;     // ausente nas versões 2 e 3
+} CabecalhoMapa;
+
+typedef struct {
+    uint32_t nome;       // índice na tabela de textos
+    uint32_t pista;      // índice na tabela de textos
+    uint32_t esquerda;   // índice da sala ou MAPA_SEM_SALA
+    uint32_t direita;
+} SalaDisco;
+
+typedef struct {
+    uint32_t pista;
+    uint32_t suspeito;
+} AssocDisco;
+
+typedef struct {
+    uint32_t origem;     // índice da sala
+    uint32_t destino;
+    uint32_t nome;       // índice na tabela de textos
+} PortaDisco;
+
+typedef struct {
+    uint32_t pista;      // índices na tabela de textos
+    uint32_t suspeito;
+    float peso;
+} PesoDisco;
+
+// Saída extra entre duas salas do bloco (por índice).
+typedef struct {
+    uint32_t origem;
+    uint32_t destino;
+    IdTexto nome;
+} PortaMapa;
+
+// Mapa carregado: as salas ficam em um único bloco (sem malloc por sala).
+typedef struct {
+    Sala *raiz;
+    Sala *bloco;     // NULL quando as salas foram criadas uma a uma com criarSala()
+    size_t nSalas;
+    PortaMapa *portas;   // só em mapas com bloco
+    size_t nPortas;
+} Mansao;
+
+static void erroMapa(const char *arquivo, size_t linha, const char *msg) {
+    if (linha) fprintf(stderr, "%s:%zu: %s\n", arquivo, linha, msg);
+    else fprintf(stderr, "%s: %s\n", arquivo, msg);
+    exit(1);
+}
+
+// Liga os ponteiros esquerda/direita do bloco de salas a partir dos índices lidos.
+static void ligarSalas(Mansao *m, const uint32_t *esq, const uint32_t *dir, const char *arquivo) {
+    for (size_t i = 0; i < m->nSalas; i++) {
+        if ((esq[i] != MAPA_SEM_SALA && esq[i] >= m->nSalas) ||
+            (dir[i] != MAPA_SEM_SALA && dir[i] >= m->nSalas))
+            erroMapa(arquivo, 0, "ligação para sala inexistente");
+        m->bloco[i].esquerda = esq[i] == MAPA_SEM_SALA ? NULL : &m->bloco[esq[i]];
+        m->bloco[i].direita = dir[i] == MAPA_SEM_SALA ? NULL : &m->bloco[dir[i]];
     }
-    int cmp = strcmp(pista, raiz->pista);
-    if (cmp < 0) {
-        raiz->esquerda = inserirPista(raiz->esquerda, pista, coletadaFlag);
-    } else if (cmp > 0) {
-        raiz->direita = inserirPista(raiz->direita, pista, coletadaFlag);
-    } else {
-        // mesma pista, não inserir duplicata
-        if (coletadaFlag) *coletadaFlag = 0;
+    for (size_t i = 0; i < m->nPortas; i++)
+        if (m->portas[i].origem >= m->nSalas || m->portas[i].destino >= m->nSalas)
+            erroMapa(arquivo, 0, "porta para sala inexistente");
+    m->raiz = m->nSalas ? &m->bloco[0] : NULL;
+}
+
+// Acrescenta uma porta ao mapa em carga (capacidade dobrando).
+static void acrescentarPorta(Mansao *m, size_t *cap, uint32_t origem, uint32_t destino, IdTexto nome) {
+    if (m->nPortas == *cap) {
+        *cap = *cap ? *cap * 2 : 1024;
+        m->portas = (PortaMapa*) realloc(m->portas, *cap * sizeof(PortaMapa));
+        if (!m->portas) { perror("malloc"); exit(1); }
+    }
+    m->portas[m->nPortas].origem = origem;
+    m->portas[m->nPortas].destino = destino;
+    m->portas[m->nPortas].nome = nome;
+    m->nPortas++;
+}
+
+static Mansao carregarMansaoTexto(FILE *f, const char *arquivo) {
+    Mansao m = { NULL, NULL, 0, NULL, 0 };
+    size_t cap = 0, capPortas = 0;
+    uint32_t *esq = NULL, *dir = NULL;
+    unsigned char *definida = NULL;
+    char linha[MAX_NOME + MAX_PISTA + 64];
+    size_t nLinha = 0;
+
+    while (fgets(linha, sizeof(linha), f)) {
+        nLinha++;
+        size_t L = strlen(linha);
+        if (L > 0 && linha[L-1] != '\n' && !feof(f)) erroMapa(arquivo, nLinha, "linha longa demais");
+        while (L > 0 && (linha[L-1] == '\n' || linha[L-1] == '\r')) linha[--L] = '\0';
+        if (L == 0 || linha[0] == '#') continue;
+
+        char *sep = strchr(linha, '|');
+        if (strncmp(linha, "sala ", 5) == 0) {
+            long idx, e, d;
+            int usados = 0;
+            if (!sep || sscanf(linha + 5, "%ld %ld %ld %n", &idx, &e, &d, &usados) != 3 || idx < 0 || idx >= (long)MAPA_SEM_SALA)
+                erroMapa(arquivo, nLinha, "esperado: sala <indice> <esquerda> <direita> <nome>|<pista>");
+            *sep = '\0';
+            if ((size_t)idx >= cap) {
+                size_t novoCap = cap ? cap : 1024;
+                while (novoCap <= (size_t)idx) novoCap *= 2;
+                m.bloco = (Sala*) realloc(m.bloco, novoCap * sizeof(Sala));
+                esq = (uint32_t*) realloc(esq, novoCap * sizeof(uint32_t));
+                dir = (uint32_t*) realloc(dir, novoCap * sizeof(uint32_t));
+                definida = (unsigned char*) realloc(definida, novoCap);
+                if (!m.bloco || !esq || !dir || !definida) { perror("malloc"); exit(1); }
+                memset(definida + cap, 0, novoCap - cap);
+                cap = novoCap;
+            }
+            if (definida[idx]) erroMapa(arquivo, nLinha, "sala declarada duas vezes");
+            definida[idx] = 1;
+            if ((size_t)idx >= m.nSalas) m.nSalas = (size_t)idx + 1;
+            m.bloco[idx].nome = internarTexto(linha + 5 + usados);
+            m.bloco[idx].pista = internarTexto(sep + 1);
+            esq[idx] = e < 0 ? MAPA_SEM_SALA : (uint32_t)e;
+            dir[idx] = d < 0 ? MAPA_SEM_SALA : (uint32_t)d;
+        } else if (strncmp(linha, "porta ", 6) == 0) {
+            long o, d;
+            int usados = 0;
+            if (sscanf(linha + 6, "%ld %ld %n", &o, &d, &usados) != 2 || usados == 0 || linha[6 + usados] == '\0' ||
+                o < 0 || d < 0 || o >= (long)MAPA_SEM_SALA || d >= (long)MAPA_SEM_SALA)
+                erroMapa(arquivo, nLinha, "esperado: porta <origem> <destino> <nome da saída>");
+            acrescentarPorta(&m, &capPortas, (uint32_t)o, (uint32_t)d, internarTexto(linha + 6 + usados));
+        } else if (strncmp(linha, "assoc ", 6) == 0) {
+            if (!sep) erroMapa(arquivo, nLinha, "esperado: assoc <pista>|<suspeito>[|<peso>]");
+            *sep = '\0';
+            char *sepPeso = strchr(sep + 1, '|');
+            if (sepPeso) {
+                char *fim;
+                *sepPeso = '\0';
+                float peso = strtof(sepPeso + 1, &fim);
+                if (fim == sepPeso + 1 || *fim != '\0' || !__builtin_isfinite(peso))
+                    erroMapa(arquivo, nLinha, "peso inválido");
+                inserirAssociacao(linha + 6, sep + 1, peso);
+            } else {
+                IdTexto pista = internarTexto(linha + 6), suspeito = internarTexto(sep + 1);
+                IdTexto principal = encontrarSuspeitoId(pista);
+                if (principal == TEXTO_NENHUM || principal == suspeito) inserirNaHash(linha + 6, sep + 1);
+                else inserirAssociacaoId(pista, suspeito, 1.0f);
+            }
+        } else {
+            erroMapa(arquivo, nLinha, "declaração desconhecida");
+        }
+    }
+    for (size_t i = 0; i < m.nSalas; i++)
+        if (!definida[i]) erroMapa(arquivo, 0, "índices de sala não são contíguos");
+    ligarSalas(&m, esq, dir, arquivo);
+    free(esq);
+    free(dir);
+    free(definida);
+    return m;
+}
+
+static Mansao carregarMansaoBinaria(int fd, size_t tamArquivo, int versao, const char *arquivo) {
+    Mansao m = { NULL, NULL, 0, NULL, 0 };
+    const unsigned char *base = (const unsigned char*) mmap(NULL, tamArquivo, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) { perror("mmap"); exit(1); }
+    // as versões 2 e 3 não têm os últimos campos do cabeçalho
+    CabecalhoMapa c;
+    size_t tamCab = versao == 2 ? offsetof(CabecalhoMapa, nPortas)
+                  : versao == 3 ? offsetof(CabecalhoMapa, nPesos) : sizeof(CabecalhoMapa);
+    if (tamArquivo < tamCab) erroMapa(arquivo, 0, "cabeçalho incompleto");
+    memcpy(&c, base, tamCab);
+    if (versao == 2) c.nPortas = 0;
+    if (versao <= 3) c.nPesos = 0;
+    const CabecalhoMapa *cab = &c;
+    size_t esperado = tamCab + (size_t)cab->nTextos * sizeof(uint32_t)
+                    + (size_t)cab->nSalas * sizeof(SalaDisco)
+                    + (size_t)cab->nAssoc * sizeof(AssocDisco)
+                    + (size_t)cab->nPortas * sizeof(PortaDisco)
+                    + (size_t)cab->nPesos * sizeof(PesoDisco) + cab->tamTexto;
+    if (esperado != tamArquivo) erroMapa(arquivo, 0, "tamanho do arquivo não confere com o cabeçalho");
+
+    const uint32_t *deslocamentos = (const uint32_t*) (base + tamCab);
+    const SalaDisco *salas = (const SalaDisco*) (deslocamentos + cab->nTextos);
+    const AssocDisco *assoc = (const AssocDisco*) (salas + cab->nSalas);
+    const PortaDisco *portas = (const PortaDisco*) (assoc + cab->nAssoc);
+    const PesoDisco *pesos = (const PesoDisco*) (portas + cab->nPortas);
+    const char *texto = (const char*) (pesos + cab->nPesos);
+    if (cab->tamTexto == 0 || texto[cab->tamTexto - 1] != '\0')
+        erroMapa(arquivo, 0, "bloco de texto não termina em '\\0'");
+
+    // textos do arquivo -> ids do pool
+    IdTexto *ids = (IdTexto*) malloc((cab->nTextos ? cab->nTextos : 1) * sizeof(IdTexto));
+    if (!ids) { perror("malloc"); exit(1); }
+    for (uint32_t i = 0; i < cab->nTextos; i++) {
+        if (deslocamentos[i] >= cab->tamTexto) erroMapa(arquivo, 0, "deslocamento de texto inválido");
+        ids[i] = internarTexto(texto + deslocamentos[i]);
+    }
+
+    m.nSalas = cab->nSalas;
+    m.bloco = (Sala*) malloc((m.nSalas ? m.nSalas : 1) * sizeof(Sala));
+    uint32_t *esq = (uint32_t*) malloc((m.nSalas ? m.nSalas : 1) * sizeof(uint32_t));
+    uint32_t *dir = (uint32_t*) malloc((m.nSalas ? m.nSalas : 1) * sizeof(uint32_t));
+    if (!m.bloco || !esq || !dir) { perror("malloc"); exit(1); }
+    for (size_t i = 0; i < m.nSalas; i++) {
+        if (salas[i].nome >= cab->nTextos || salas[i].pista >= cab->nTextos)
+            erroMapa(arquivo, 0, "índice de texto inválido");
+        m.bloco[i].nome = ids[salas[i].nome];
+        m.bloco[i].pista = ids[salas[i].pista];
+        esq[i] = salas[i].esquerda;
+        dir[i] = salas[i].direita;
+    }
+    tabelaReservar(&hashPistaToSuspeito, hashPistaToSuspeito.quantidade + cab->nAssoc);
+    for (uint32_t i = 0; i < cab->nAssoc; i++) {
+        if (assoc[i].pista >= cab->nTextos || assoc[i].suspeito >= cab->nTextos)
+            erroMapa(arquivo, 0, "índice de texto inválido");
+        IdTexto *valor = (IdTexto*) tabelaInserir(&hashPistaToSuspeito, &ids[assoc[i].pista], NULL);
+        *valor = ids[assoc[i].suspeito];
+    }
+    if (cab->nPortas) {
+        m.portas = (PortaMapa*) malloc(cab->nPortas * sizeof(PortaMapa));
+        if (!m.portas) { perror("malloc"); exit(1); }
+    }
+    for (uint32_t i = 0; i < cab->nPortas; i++) {
+        if (portas[i].nome >= cab->nTextos) erroMapa(arquivo, 0, "índice de texto inválido");
+        m.portas[i].origem = portas[i].origem;
+        m.portas[i].destino = portas[i].destino;
+        m.portas[i].nome = ids[portas[i].nome];
+    }
+    m.nPortas = cab->nPortas;
+    tabelaReservar(&pesosPistaSuspeito, pesosPistaSuspeito.quantidade + cab->nPesos);
+    for (uint32_t i = 0; i < cab->nPesos; i++) {
+        if (pesos[i].pista >= cab->nTextos || pesos[i].suspeito >= cab->nTextos)
+            erroMapa(arquivo, 0, "índice de texto inválido");
+        if (!__builtin_isfinite(pesos[i].peso)) erroMapa(arquivo, 0, "peso inválido");
+        inserirAssociacaoId(ids[pesos[i].pista], ids[pesos[i].suspeito], pesos[i].peso);
+    }
+    ligarSalas(&m, esq, dir, arquivo);
+    free(ids);
+    free(esq);
+    free(dir);
+    munmap((void*) base, tamArquivo);
+    return m;
+}
+
+/*
+ carregarMansao(arquivo):
+ - lê o mapa (formato texto ou binário, detectado pelo cabeçalho).
+ - as associações pista -> suspeito vão para hashPistaToSuspeito e as
+   ponderadas para pesosPistaSuspeito.
+ - retorna a Mansao com a raiz (sala de índice 0).
+*/
+Mansao carregarMansao(const char *arquivo) {
+    int fd = open(arquivo, O_RDONLY);
+    if (fd < 0) { perror(arquivo); exit(1); }
+    struct stat st;
+    if (fstat(fd, &st) != 0) { perror(arquivo); exit(1); }
+
+    char magico[4] = {0};
+    Mansao m;
+    int versao = 0;
+    if (read(fd, magico, 4) == 4) {
+        if (memcmp(magico, MAPA_MAGICO, 4) == 0) versao = 4;
+        else if (memcmp(magico, MAPA_MAGICO_V3, 4) == 0) versao = 3;
+        else if (memcmp(magico, MAPA_MAGICO_V2, 4) == 0) versao = 2;
+    }
+    if (versao) {
+        m = carregarMansaoBinaria(fd, (size_t)st.st_size, versao, arquivo);
+        close(fd);
+    } else {
+        FILE *f = fdopen(fd, "r");
+        if (!f) { perror(arquivo); exit(1); }
+        rewind(f);
+        m = carregarMansaoTexto(f, arquivo);
+        fclose(f);
+    }
+    if (!m.raiz) erroMapa(arquivo, 0, "mapa sem salas");
+    return m;
+}
+
+// Lista as salas em ordem de largura (BFS) e devolve, para cada uma, os índices dos filhos.
+static Sala** listarSalasBFS(Sala *raiz, size_t *n, uint32_t **esq, uint32_t **dir) {
+    size_t cap = 1024, total = 0;
+    Sala **fila = (Sala**) malloc(cap * sizeof(Sala*));
+    *esq = (uint32_t*) malloc(cap * sizeof(uint32_t));
+    *dir = (uint32_t*) malloc(cap * sizeof(uint32_t));
+    if (!fila || !*esq || !*dir) { perror("malloc"); exit(1); }
+    if (raiz) fila[total++] = raiz;
+    for (size_t i = 0; i < total; i++) {
+        if (total + 2 > cap) {
+            cap *= 2;
+            fila = (Sala**) realloc(fila, cap * sizeof(Sala*));
+            *esq = (uint32_t*) realloc(*esq, cap * sizeof(uint32_t));
+            *dir = (uint32_t*) realloc(*dir, cap * sizeof(uint32_t));
+            if (!fila || !*esq || !*dir) { perror("malloc"); exit(1); }
+        }
+        (*esq)[i] = fila[i]->esquerda ? (uint32_t)total : MAPA_SEM_SALA;
+        if (fila[i]->esquerda) fila[total++] = fila[i]->esquerda;
+        (*dir)[i] = fila[i]->direita ? (uint32_t)total : MAPA_SEM_SALA;
+        if (fila[i]->direita) fila[total++] = fila[i]->direita;
+    }
+    *n = total;
+    return fila;
+}
+
+// Salas na ordem de gravação: BFS a partir da raiz. Mapas com portas mantêm a
+// ordem do bloco, porque as portas se referem às salas pelo índice.
+static Sala** listarSalasParaGravar(const Mansao *m, size_t *n, uint32_t **esq, uint32_t **dir) {
+    if (m->nPortas == 0) return listarSalasBFS(m->raiz, n, esq, dir);
+    size_t k = m->nSalas;
+    Sala **salas = (Sala**) malloc(k * sizeof(Sala*));
+    *esq = (uint32_t*) malloc(k * sizeof(uint32_t));
+    *dir = (uint32_t*) malloc(k * sizeof(uint32_t));
+    if (!salas || !*esq || !*dir) { perror("malloc"); exit(1); }
+    for (size_t i = 0; i < k; i++) {
+        salas[i] = &m->bloco[i];
+        (*esq)[i] = m->bloco[i].esquerda ? (uint32_t)(m->bloco[i].esquerda - m->bloco) : MAPA_SEM_SALA;
+        (*dir)[i] = m->bloco[i].direita ? (uint32_t)(m->bloco[i].direita - m->bloco) : MAPA_SEM_SALA;
+    }
+    *n = k;
+    return salas;
+}
+
+// Grava o mapa no formato texto (salas, portas e depois as associações).
+void salvarMansaoTexto(const Mansao *m, const char *arquivo) {
+    FILE *f = fopen(arquivo, "w");
+    if (!f) { perror(arquivo); exit(1); }
+    size_t n;
+    uint32_t *esq, *dir;
+    Sala **salas = listarSalasParaGravar(m, &n, &esq, &dir);
+    fprintf(f, "# Detective Quest - mapa da mansão\n");
+    for (size_t i = 0; i < n; i++)
+        fprintf(f, "sala %zu %ld %ld %s|%s\n", i,
+                esq[i] == MAPA_SEM_SALA ? -1L : (long)esq[i],
+                dir[i] == MAPA_SEM_SALA ? -1L : (long)dir[i],
+                textoDe(salas[i]->nome), textoDe(salas[i]->pista));
+    for (size_t i = 0; i < m->nPortas; i++)
+        fprintf(f, "porta %lu %lu %s\n", (unsigned long) m->portas[i].origem,
+                (unsigned long) m->portas[i].destino, textoDe(m->portas[i].nome));
+    const TabelaHash *t = &hashPistaToSuspeito;
+    for (size_t i = 0; i < t->capacidade; i++) {
+        if (!t->hashes[i]) continue;
+        const IdTexto *par = (const IdTexto*) tabelaSlot(t, i);
+        fprintf(f, "assoc %s|%s\n", textoDe(par[0]), textoDe(par[1]));
+    }
+    const TabelaHash *tp = &pesosPistaSuspeito;
+    for (size_t i = 0; i < tp->capacidade; i++) {
+        if (!tp->hashes[i]) continue;
+        const IdTexto *par = (const IdTexto*) tabelaSlot(tp, i);
+        float peso;
+        memcpy(&peso, par + 2, sizeof(float));
+        fprintf(f, "assoc %s|%s|%.9g\n", textoDe(par[0]), textoDe(par[1]), (double) peso);
+    }
+    free(salas); free(esq); free(dir);
+    if (fclose(f) != 0) { perror(arquivo); exit(1); }
+}
+
+// Tabela de textos de um .dqm em construção: cada id do pool entra uma vez.
+typedef struct {
+    uint32_t *indiceNoArquivo;  // IdTexto -> índice na tabela do arquivo (MAPA_SEM_SALA = ainda não usado)
+    uint32_t *deslocamentos;
+    uint32_t nTextos;
+    char *texto;
+    size_t tamTexto, capTexto;
+} TextosArquivo;
+
+static uint32_t guardarTexto(TextosArquivo *ta, IdTexto id) {
+    if (ta->indiceNoArquivo[id] != MAPA_SEM_SALA) return ta->indiceNoArquivo[id];
+    const char *s = textoDe(id);
+    size_t L = strlen(s) + 1;
+    while (ta->tamTexto + L > ta->capTexto) {
+        ta->capTexto = ta->capTexto ? ta->capTexto * 2 : 4096;
+        ta->texto = (char*) realloc(ta->texto, ta->capTexto);
+        if (!ta->texto) { perror("malloc"); exit(1); }
+    }
+    memcpy(ta->texto + ta->tamTexto, s, L);
+    ta->deslocamentos[ta->nTextos] = (uint32_t) ta->tamTexto;
+    ta->tamTexto += L;
+    if (ta->tamTexto > 0xFFFFFFFFu) { fprintf(stderr, "bloco de texto do mapa grande demais\n"); exit(1); }
+    return ta->indiceNoArquivo[id] = ta->nTextos++;
+}
+
+// Grava o mapa no formato binário (.dqm).
+void salvarMansaoBinaria(const Mansao *m, const char *arquivo) {
+    size_t n;
+    uint32_t *esq, *dir;
+    Sala **salas = listarSalasParaGravar(m, &n, &esq, &dir);
+    const TabelaHash *t = &hashPistaToSuspeito, *tp = &pesosPistaSuspeito;
+
+    TextosArquivo ta = { NULL, NULL, 0, NULL, 0, 0 };
+    size_t nPool = textosInternos.quantidade ? textosInternos.quantidade : 1;
+    ta.indiceNoArquivo = (uint32_t*) malloc(nPool * sizeof(uint32_t));
+    ta.deslocamentos = (uint32_t*) malloc(nPool * sizeof(uint32_t));
+    SalaDisco *sd = (SalaDisco*) malloc((n ? n : 1) * sizeof(SalaDisco));
+    AssocDisco *ad = (AssocDisco*) malloc((t->quantidade ? t->quantidade : 1) * sizeof(AssocDisco));
+    PortaDisco *pd = (PortaDisco*) malloc((m->nPortas ? m->nPortas : 1) * sizeof(PortaDisco));
+    PesoDisco *wd = (PesoDisco*) malloc((tp->quantidade ? tp->quantidade : 1) * sizeof(PesoDisco));
+    if (!ta.indiceNoArquivo || !ta.deslocamentos || !sd || !ad || !pd || !wd) { perror("malloc"); exit(1); }
+    memset(ta.indiceNoArquivo, 0xFF, nPool * sizeof(uint32_t));
+
+    guardarTexto(&ta, internarTexto(""));   // texto 0 do arquivo é sempre ""
+    for (size_t i = 0; i < n; i++) {
+        sd[i].nome = guardarTexto(&ta, salas[i]->nome);
+        sd[i].pista = guardarTexto(&ta, salas[i]->pista);
+        sd[i].esquerda = esq[i];
+        sd[i].direita = dir[i];
+    }
+    size_t nAssoc = 0;
+    for (size_t i = 0; i < t->capacidade; i++) {
+        if (!t->hashes[i]) continue;
+        const IdTexto *par = (const IdTexto*) tabelaSlot(t, i);
+        ad[nAssoc].pista = guardarTexto(&ta, par[0]);
+        ad[nAssoc].suspeito = guardarTexto(&ta, par[1]);
+        nAssoc++;
+    }
+    for (size_t i = 0; i < m->nPortas; i++) {
+        pd[i].origem = m->portas[i].origem;
+        pd[i].destino = m->portas[i].destino;
+        pd[i].nome = guardarTexto(&ta, m->portas[i].nome);
+    }
+    size_t nPesos = 0;
+    for (size_t i = 0; i < tp->capacidade; i++) {
+        if (!tp->hashes[i]) continue;
+        const IdTexto *par = (const IdTexto*) tabelaSlot(tp, i);
+        wd[nPesos].pista = guardarTexto(&ta, par[0]);
+        wd[nPesos].suspeito = guardarTexto(&ta, par[1]);
+        memcpy(&wd[nPesos].peso, par + 2, sizeof(float));
+        nPesos++;
+    }
+
+    CabecalhoMapa cab;
+    memcpy(cab.magico, MAPA_MAGICO, 4);
+    cab.nSalas = (uint32_t) n;
+    cab.nAssoc = (uint32_t) nAssoc;
+    cab.nTextos = ta.nTextos;
+    cab.tamTexto = (uint32_t) ta.tamTexto;
+    cab.nPortas = (uint32_t) m->nPortas;
+    cab.nPesos = (uint32_t) nPesos;
+
+    FILE *f = fopen(arquivo, "wb");
+    if (!f) { perror(arquivo); exit(1); }
+    if (fwrite(&cab, sizeof(cab), 1, f) != 1 ||
+        fwrite(ta.deslocamentos, sizeof(uint32_t), ta.nTextos, f) != ta.nTextos ||
+        fwrite(sd, sizeof(SalaDisco), n, f) != n ||
+        fwrite(ad, sizeof(AssocDisco), nAssoc, f) != nAssoc ||
+        fwrite(pd, sizeof(PortaDisco), m->nPortas, f) != m->nPortas ||
+        fwrite(wd, sizeof(PesoDisco), nPesos, f) != nPesos ||
+        fwrite(ta.texto, 1, ta.tamTexto, f) != ta.tamTexto ||
+        fclose(f) != 0) { perror(arquivo); exit(1); }
+
+    free(ta.indiceNoArquivo); free(ta.deslocamentos); free(ta.texto);
+    free(sd); free(ad); free(pd); free(wd);
+    free(salas); free(esq); free(dir);
+}
+
+// ---------------------- MAPA COMPACTO ----------------------
+
+// Representação compilada do mapa para percursos em massa (modo lote):
+// as salas ficam em um vetor contíguo em ordem de largura (BFS), com filhos
+// como índices de 32 bits. Só os campos usados a cada movimento (filhos e
+// pista) ficam no vetor quente; os nomes, usados apenas na exibição, ficam
+// em um vetor frio à parte. Com 12 bytes por sala, os níveis de cima da
+// árvore cabem em poucas linhas de cache.
+typedef struct {
+    uint32_t esquerda;   // índice da sala ou MAPA_SEM_SALA
+    uint32_t direita;
+    IdTexto pista;
+} SalaCompacta;
+
+typedef struct {
+    SalaCompacta *salas;   // salas[0] é a entrada
+    IdTexto *nomes;
+    uint32_t nSalas;
+} MapaCompacto;
+
+// Compila a árvore de salas a partir da raiz.
+MapaCompacto compilarMapa(Sala *raiz) {
+    MapaCompacto m;
+    size_t n;
+    uint32_t *esq, *dir;
+    Sala **salas = listarSalasBFS(raiz, &n, &esq, &dir);
+    if (n >= MAPA_SEM_SALA) { fprintf(stderr, "mapa grande demais para índices de 32 bits\n"); exit(1); }
+    m.nSalas = (uint32_t) n;
+    m.salas = (SalaCompacta*) malloc((n ? n : 1) * sizeof(SalaCompacta));
+    m.nomes = (IdTexto*) malloc((n ? n : 1) * sizeof(IdTexto));
+    if (!m.salas || !m.nomes) { perror("malloc"); exit(1); }
+    for (size_t i = 0; i < n; i++) {
+        m.salas[i].esquerda = esq[i];
+        m.salas[i].direita = dir[i];
+        m.salas[i].pista = salas[i]->pista;
+        m.nomes[i] = salas[i]->nome;
+    }
+    free(salas); free(esq); free(dir);
+    return m;
+}
+
+void liberarMapaCompacto(MapaCompacto *m) {
+    free(m->salas);
+    free(m->nomes);
+    m->salas = NULL;
+    m->nomes = NULL;
+    m->nSalas = 0;
+}
+
+// Índice da sala alcançada pela escolha ('e'/'d'), ou MAPA_SEM_SALA.
+static inline uint32_t salaVizinhaCompacta(const MapaCompacto *m, uint32_t atual, char escolha) {
+    if (escolha == 'e' || escolha == 'E') return m->salas[atual].esquerda;
+    if (escolha == 'd' || escolha == 'D') return m->salas[atual].direita;
+    return MAPA_SEM_SALA;
+}
+
+// ---------------------- CATÁLOGO DE PISTAS ----------------------
+
+/*
+ As pistas das salas do mapa são conhecidas na carga: cada pista distinta
+ recebe um id denso (0..n-1) em ordem alfabética, e as sessões marcam as
+ coletadas num bitset indexado por esse id. Como a ordem dos ids é a ordem
+ alfabética, varrer o bitset já dá as pistas ordenadas, e o bitset é também o
+ formato do snapshot de sessão.
+ Uma pista que não está em nenhuma sala do mapa é acrescentada ao fim do
+ catálogo quando é coletada pela primeira vez (fora da ordem alfabética).
+ Depois de catalogarPistas() o catálogo só é lido, então as sessões do modo
+ lote podem consultá-lo em paralelo.
+*/
+#define PISTA_FORA_DO_CATALOGO 0xFFFFFFFFu
+
+typedef struct {
+    IdTexto *pistas;        // id denso -> pista
+    IdTexto *suspeitos;     // id denso -> suspeito da pista (TEXTO_NENHUM se não há)
+    uint32_t quantidade;
+    uint32_t capacidade;
+    uint32_t nMapa;         // os nMapa primeiros ids são as pistas do mapa, em ordem alfabética
+    uint32_t *denso;        // IdTexto -> id denso (PISTA_FORA_DO_CATALOGO)
+    size_t nDenso;
+    uint64_t impressao;     // FNV-1a das pistas do mapa em ordem (estável entre máquinas)
+} CatalogoPistas;
+
+CatalogoPistas catalogoPistas;
+
+static int compararTextos(const void *a, const void *b) {
+    return strcmp(textoDe(*(const IdTexto*) a), textoDe(*(const IdTexto*) b));
+}
+
+static void crescerCatalogo(CatalogoPistas *c, uint32_t quantidade) {
+    if (quantidade > c->capacidade) {
+        c->capacidade = quantidade > 2 * c->capacidade ? quantidade : 2 * c->capacidade;
+        c->pistas = (IdTexto*) realloc(c->pistas, c->capacidade * sizeof(IdTexto));
+        c->suspeitos = (IdTexto*) realloc(c->suspeitos, c->capacidade * sizeof(IdTexto));
+        if (!c->pistas || !c->suspeitos) { perror("malloc"); exit(1); }
+    }
+    if (textosInternos.quantidade > c->nDenso) {
+        size_t n = textosInternos.quantidade > 2 * c->nDenso ? textosInternos.quantidade : 2 * c->nDenso;
+        c->denso = (uint32_t*) realloc(c->denso, n * sizeof(uint32_t));
+        if (!c->denso) { perror("malloc"); exit(1); }
+        memset(c->denso + c->nDenso, 0xFF, (n - c->nDenso) * sizeof(uint32_t));
+        c->nDenso = n;
+    }
+}
+
+/*
+ Matriz de evidências: quanto cada pista do mapa pesa sobre cada suspeito.
+ Os suspeitos citados pelas pistas do mapa recebem ids densos em ordem
+ alfabética e cada pista vira uma linha (CSR) com os pesos em ordem de
+ suspeito: o do suspeito principal (1, ou o peso explícito do par) e os de
+ pesosPistaSuspeito. Coletar uma pista soma a linha dela aos pontos da sessão
+ (somarEvidencias()): o custo é o tamanho da linha, não o número de suspeitos
+ nem o de pistas já coletadas.
+ Linhas com MIN_LINHA_DENSA pesos ou mais, espalhados por no máximo o dobro
+ disso em suspeitos vizinhos, são guardadas densas: a faixa inteira, com zeros
+ nos buracos, somada com instruções vetoriais em vez de um acesso por peso.
+ Montada por catalogarPistas() e só lida depois, como o catálogo.
+*/
+#define LINHA_ESPARSA 0xFFFFFFFFu
+#define MIN_LINHA_DENSA 8
+#define SUSPEITO_FORA_DA_MATRIZ 0xFFFFFFFFu
+
+typedef struct {
+    IdTexto *suspeitos;     // id denso do suspeito -> suspeito
+    uint32_t nSuspeitos;
+    uint32_t capSuspeitos;
+    uint32_t *idSuspeito;   // IdTexto -> id denso (SUSPEITO_FORA_DA_MATRIZ)
+    size_t nIdSuspeito;
+    uint32_t nLinhas;       // uma por pista do mapa (os nMapa primeiros ids do catálogo)
+    uint32_t *inicioLinha;  // linha d: pesos[inicioLinha[d] .. inicioLinha[d + 1])
+    uint32_t *baseDensa;    // primeiro suspeito da faixa de uma linha densa, ou LINHA_ESPARSA
+    uint32_t *colunas;      // suspeito de cada peso (nas linhas densas, base + j)
+    float *pesos;
+    uint32_t nDensas;
+} MatrizEvidencias;
+
+MatrizEvidencias matrizEvidencias;
+
+// Peso de uma pista sobre um suspeito, antes de virar linha da matriz.
+typedef struct {
+    uint32_t linha;     // id denso da pista
+    uint32_t coluna;    // suspeito (IdTexto e depois id denso)
+    float peso;
+} EntradaMatriz;
+
+static void crescerSuspeitosMatriz(MatrizEvidencias *mz, uint32_t quantidade) {
+    if (quantidade > mz->capSuspeitos) {
+        mz->capSuspeitos = quantidade > 2 * mz->capSuspeitos ? quantidade : 2 * mz->capSuspeitos;
+        mz->suspeitos = (IdTexto*) realloc(mz->suspeitos, mz->capSuspeitos * sizeof(IdTexto));
+        if (!mz->suspeitos) { perror("malloc"); exit(1); }
+    }
+    if (textosInternos.quantidade > mz->nIdSuspeito) {
+        size_t n = textosInternos.quantidade > 2 * mz->nIdSuspeito ? textosInternos.quantidade : 2 * mz->nIdSuspeito;
+        mz->idSuspeito = (uint32_t*) realloc(mz->idSuspeito, n * sizeof(uint32_t));
+        if (!mz->idSuspeito) { perror("malloc"); exit(1); }
+        memset(mz->idSuspeito + mz->nIdSuspeito, 0xFF, (n - mz->nIdSuspeito) * sizeof(uint32_t));
+        mz->nIdSuspeito = n;
+    }
+}
+
+// Id denso do suspeito, ou SUSPEITO_FORA_DA_MATRIZ se nenhuma pista o cita. O(1).
+uint32_t idSuspeitoMatriz(IdTexto suspeito) {
+    const MatrizEvidencias *mz = &matrizEvidencias;
+    return suspeito < mz->nIdSuspeito ? mz->idSuspeito[suspeito] : SUSPEITO_FORA_DA_MATRIZ;
+}
+
+// Id denso do suspeito, acrescentando-o ao fim da matriz (sem linhas) se ele não estiver lá.
+uint32_t idDensoSuspeito(IdTexto suspeito) {
+    MatrizEvidencias *mz = &matrizEvidencias;
+    uint32_t d = idSuspeitoMatriz(suspeito);
+    if (d != SUSPEITO_FORA_DA_MATRIZ) return d;
+    crescerSuspeitosMatriz(mz, mz->nSuspeitos + 1);
+    d = mz->nSuspeitos++;
+    mz->suspeitos[d] = suspeito;
+    mz->idSuspeito[suspeito] = d;
+    return d;
+}
+
+// Ordenação por contagem (estável) das entradas pela linha ou pela coluna.
+static void distribuirEntradas(const EntradaMatriz *de, EntradaMatriz *para, size_t n, size_t nChaves, int porLinha) {
+    size_t *inicio = (size_t*) calloc(nChaves + 1, sizeof(size_t));
+    if (!inicio) { perror("malloc"); exit(1); }
+    for (size_t i = 0; i < n; i++) inicio[(porLinha ? de[i].linha : de[i].coluna) + 1]++;
+    for (size_t k = 0; k < nChaves; k++) inicio[k + 1] += inicio[k];
+    for (size_t i = 0; i < n; i++) para[inicio[porLinha ? de[i].linha : de[i].coluna]++] = de[i];
+    free(inicio);
+}
+
+/*
+ montarMatrizEvidencias():
+ - refaz a matriz a partir do catálogo (pistas do mapa e seus suspeitos
+   principais) e de pesosPistaSuspeito. Pesos de pistas que não estão em
+   nenhuma sala do mapa ficam de fora.
+ - O(pesos + suspeitos log suspeitos): duas passadas de ordenação por contagem
+   deixam cada linha agrupada e em ordem de suspeito.
+*/
+static void montarMatrizEvidencias(void) {
+    MatrizEvidencias *mz = &matrizEvidencias;
+    const CatalogoPistas *c = &catalogoPistas;
+    const TabelaHash *tp = &pesosPistaSuspeito;
+    for (uint32_t i = 0; i < mz->nSuspeitos; i++) mz->idSuspeito[mz->suspeitos[i]] = SUSPEITO_FORA_DA_MATRIZ;
+    mz->nSuspeitos = 0;
+
+    size_t n = 0, cap = (size_t) c->nMapa + tp->quantidade;
+    EntradaMatriz *e = (EntradaMatriz*) malloc((cap ? cap : 1) * sizeof(EntradaMatriz));
+    EntradaMatriz *ord = (EntradaMatriz*) malloc((cap ? cap : 1) * sizeof(EntradaMatriz));
+    if (!e || !ord) { perror("malloc"); exit(1); }
+    for (uint32_t d = 0; d < c->nMapa; d++) {
+        IdTexto par[2] = { c->pistas[d], c->suspeitos[d] };
+        if (par[1] == TEXTO_NENHUM || tabelaBuscar(tp, par)) continue;   // o peso explícito vem abaixo
+        e[n].linha = d;
+        e[n].coluna = par[1];
+        e[n].peso = 1.0f;
+        n++;
+    }
+    for (size_t i = 0; i < tp->capacidade; i++) {
+        if (!tp->hashes[i]) continue;
+        const IdTexto *par = (const IdTexto*) tabelaSlot(tp, i);
+        if (par[0] >= c->nDenso || c->denso[par[0]] >= c->nMapa) continue;   // pista fora do mapa
+        e[n].linha = c->denso[par[0]];
+        e[n].coluna = par[1];
+        memcpy(&e[n].peso, par + 2, sizeof(float));
+        n++;
+    }
+
+    // suspeitos citados, em ordem alfabética
+    for (size_t i = 0; i < n; i++) {
+        crescerSuspeitosMatriz(mz, mz->nSuspeitos + 1);
+        if (mz->idSuspeito[e[i].coluna] != SUSPEITO_FORA_DA_MATRIZ) continue;
+        mz->idSuspeito[e[i].coluna] = 0;
+        mz->suspeitos[mz->nSuspeitos++] = e[i].coluna;
+    }
+    qsort(mz->suspeitos, mz->nSuspeitos, sizeof(IdTexto), compararTextos);
+    for (uint32_t i = 0; i < mz->nSuspeitos; i++) mz->idSuspeito[mz->suspeitos[i]] = i;
+    for (size_t i = 0; i < n; i++) e[i].coluna = mz->idSuspeito[e[i].coluna];
+    distribuirEntradas(e, ord, n, mz->nSuspeitos, 0);
+    distribuirEntradas(ord, e, n, c->nMapa, 1);
+
+    // tamanho e formato de cada linha
+    mz->nLinhas = c->nMapa;
+    mz->inicioLinha = (uint32_t*) realloc(mz->inicioLinha, ((size_t) mz->nLinhas + 1) * sizeof(uint32_t));
+    mz->baseDensa = (uint32_t*) realloc(mz->baseDensa, (mz->nLinhas ? mz->nLinhas : 1) * sizeof(uint32_t));
+    if (!mz->inicioLinha || !mz->baseDensa) { perror("malloc"); exit(1); }
+    size_t total = 0, k = 0;
+    mz->nDensas = 0;
+    for (uint32_t d = 0; d < mz->nLinhas; d++) {
+        size_t ini = k;
+        while (k < n && e[k].linha == d) k++;
+        size_t nPesos = k - ini, faixa = nPesos ? (size_t)(e[k - 1].coluna - e[ini].coluna) + 1 : 0;
+        mz->inicioLinha[d] = (uint32_t) total;
+        if (nPesos >= MIN_LINHA_DENSA && faixa <= 2 * nPesos) {
+            mz->baseDensa[d] = e[ini].coluna;
+            total += faixa;
+            mz->nDensas++;
+        } else {
+            mz->baseDensa[d] = LINHA_ESPARSA;
+            total += nPesos;
+        }
+        if (total > 0xFFFFFFFFu) { fprintf(stderr, "matriz de evidências grande demais\n"); exit(1); }
+    }
+    mz->inicioLinha[mz->nLinhas] = (uint32_t) total;
+
+    mz->colunas = (uint32_t*) realloc(mz->colunas, (total ? total : 1) * sizeof(uint32_t));
+    mz->pesos = (float*) realloc(mz->pesos, (total ? total : 1) * sizeof(float));
+    if (!mz->colunas || !mz->pesos) { perror("malloc"); exit(1); }
+    k = 0;
+    for (uint32_t d = 0; d < mz->nLinhas; d++) {
+        uint32_t ini = mz->inicioLinha[d], fim = mz->inicioLinha[d + 1], base = mz->baseDensa[d];
+        if (base != LINHA_ESPARSA) {
+            for (uint32_t j = ini; j < fim; j++) {
+                mz->colunas[j] = base + (j - ini);
+                mz->pesos[j] = 0.0f;
+            }
+            for (; k < n && e[k].linha == d; k++) mz->pesos[ini + (e[k].coluna - base)] = e[k].peso;
+        } else {
+            for (uint32_t j = ini; j < fim; j++, k++) {
+                mz->colunas[j] = e[k].coluna;
+                mz->pesos[j] = e[k].peso;
+            }
+        }
+    }
+    free(e);
+    free(ord);
+}
+
+void liberarMatrizEvidencias() {
+    MatrizEvidencias *mz = &matrizEvidencias;
+    free(mz->suspeitos);
+    free(mz->idSuspeito);
+    free(mz->inicioLinha);
+    free(mz->baseDensa);
+    free(mz->colunas);
+    free(mz->pesos);
+    memset(mz, 0, sizeof(*mz));
+}
+
+/*
+ Índice pista <-> suspeito: para cada pista do mapa, os suspeitos sobre os
+ quais ela pesa (peso diferente de zero na matriz), e para cada suspeito da
+ matriz, as pistas que pesam sobre ele. As duas direções guardam ids densos
+ em ordem crescente (alfabética), em blocos de IDS_POR_BLOCO: o primeiro id
+ de cada bloco fica numa tabela à parte e os demais viram a diferença para o
+ anterior em varint (7 bits por byte; o bit alto diz que há mais um byte).
+ Ids vizinhos custam um byte em vez de quatro, e a tabela dos primeiros ids
+ deixa uma interseção pular blocos inteiros sem decodificá-los.
+ Montado junto com a matriz (catalogarPistas()) e só lido depois.
+*/
+#define IDS_POR_BLOCO 128
+
+typedef struct {
+    uint32_t nListas;
+    uint32_t *tamanho;          // número de ids da lista i
+    uint32_t *primeiroBloco;    // blocos da lista i: primeiroBloco[i] .. primeiroBloco[i + 1]
+    uint32_t *idInicial;        // primeiro id de cada bloco
+    size_t *inicioBloco;        // demais ids do bloco j: bytes[inicioBloco[j] .. inicioBloco[j + 1])
+    unsigned char *bytes;
+    uint32_t nBlocos;
+} ListasIds;
+
+typedef struct {
+    ListasIds suspeitosDaPista;     // id denso da pista -> ids densos dos suspeitos
+    ListasIds pistasDoSuspeito;     // id denso do suspeito -> ids densos das pistas
+    size_t nAssociacoes;
+} IndiceAssociacoes;
+
+IndiceAssociacoes indiceAssociacoes;
+
+static size_t tamanhoVarint(uint32_t v) {
+    size_t n = 1;
+    while (v >= 0x80) { v >>= 7; n++; }
+    return n;
+}
+
+static unsigned char* escreverVarint(unsigned char *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char) v;
+    return p;
+}
+
+static inline const unsigned char* lerVarint(const unsigned char *p, uint32_t *v) {
+    if (*p < 0x80) { *v = *p; return p + 1; }   // diferenças pequenas: o caso comum
+    uint32_t x = 0;
+    for (unsigned desloc = 0; ; desloc += 7) {
+        x |= (uint32_t)(*p & 0x7F) << desloc;
+        if (!(*p++ & 0x80)) break;
+    }
+    *v = x;
+    return p;
+}
+
+/*
+ montarListasIds(l, nListas, e, n, porLinha):
+ - refaz as listas com as n entradas, que já vêm agrupadas pela chave (a
+   linha, ou a coluna se !porLinha) e, dentro dela, em ordem crescente do
+   outro id, sem repetição.
+ - duas passadas: a primeira mede os blocos, a segunda escreve os bytes.
+*/
+static void montarListasIds(ListasIds *l, uint32_t nListas, const EntradaMatriz *e, size_t n, int porLinha) {
+    l->nListas = nListas;
+    l->tamanho = (uint32_t*) realloc(l->tamanho, (nListas ? nListas : 1) * sizeof(uint32_t));
+    l->primeiroBloco = (uint32_t*) realloc(l->primeiroBloco, ((size_t) nListas + 1) * sizeof(uint32_t));
+    if (!l->tamanho || !l->primeiroBloco) { perror("malloc"); exit(1); }
+    memset(l->tamanho, 0, nListas * sizeof(uint32_t));
+    for (size_t k = 0; k < n; k++) l->tamanho[porLinha ? e[k].linha : e[k].coluna]++;
+    size_t nBlocos = 0;
+    for (uint32_t i = 0; i < nListas; i++) {
+        l->primeiroBloco[i] = (uint32_t) nBlocos;
+        nBlocos += (l->tamanho[i] + IDS_POR_BLOCO - 1) / IDS_POR_BLOCO;
+    }
+    l->primeiroBloco[nListas] = (uint32_t) nBlocos;
+    l->nBlocos = (uint32_t) nBlocos;
+    l->idInicial = (uint32_t*) realloc(l->idInicial, (nBlocos ? nBlocos : 1) * sizeof(uint32_t));
+    l->inicioBloco = (size_t*) realloc(l->inicioBloco, (nBlocos + 1) * sizeof(size_t));
+    if (!l->idInicial || !l->inicioBloco) { perror("malloc"); exit(1); }
+
+    size_t nBytes = 0, b = 0;
+    uint32_t pos = 0, chave = 0, id = 0, anterior = 0;
+    for (size_t k = 0; k < n; k++, anterior = id) {
+        uint32_t c = porLinha ? e[k].linha : e[k].coluna;
+        id = porLinha ? e[k].coluna : e[k].linha;
+        pos = k > 0 && c == chave ? pos + 1 : 0;
+        chave = c;
+        if (pos % IDS_POR_BLOCO == 0) {
+            l->inicioBloco[b] = nBytes;
+            l->idInicial[b++] = id;
+        } else {
+            nBytes += tamanhoVarint(id - anterior);
+        }
+    }
+    l->inicioBloco[nBlocos] = nBytes;
+    l->bytes = (unsigned char*) realloc(l->bytes, nBytes ? nBytes : 1);
+    if (!l->bytes) { perror("malloc"); exit(1); }
+    unsigned char *p = l->bytes;
+    for (size_t k = 0; k < n; k++, anterior = id) {
+        uint32_t c = porLinha ? e[k].linha : e[k].coluna;
+        id = porLinha ? e[k].coluna : e[k].linha;
+        pos = k > 0 && c == chave ? pos + 1 : 0;
+        chave = c;
+        if (pos % IDS_POR_BLOCO != 0) p = escreverVarint(p, id - anterior);
+    }
+}
+
+/*
+ montarIndiceAssociacoes():
+ - refaz as duas direções do índice a partir da matriz de evidências. As
+   linhas da matriz já dão pista -> suspeitos em ordem; uma ordenação por
+   contagem (estável) pelo suspeito dá suspeito -> pistas em ordem.
+ - O(associações + pistas + suspeitos).
+*/
+static void montarIndiceAssociacoes(void) {
+    const MatrizEvidencias *mz = &matrizEvidencias;
+    IndiceAssociacoes *ix = &indiceAssociacoes;
+    size_t total = mz->nLinhas ? mz->inicioLinha[mz->nLinhas] : 0, n = 0;
+    EntradaMatriz *e = (EntradaMatriz*) malloc((total ? total : 1) * sizeof(EntradaMatriz));
+    EntradaMatriz *ord = (EntradaMatriz*) malloc((total ? total : 1) * sizeof(EntradaMatriz));
+    if (!e || !ord) { perror("malloc"); exit(1); }
+    for (uint32_t d = 0; d < mz->nLinhas; d++) {
+        for (uint32_t j = mz->inicioLinha[d]; j < mz->inicioLinha[d + 1]; j++) {
+            if (mz->pesos[j] == 0.0f) continue;   // buraco de linha densa (ou peso nulo): não associa
+            e[n].linha = d;
+            e[n].coluna = mz->colunas[j];
+            e[n].peso = mz->pesos[j];
+            n++;
+        }
+    }
+    montarListasIds(&ix->suspeitosDaPista, mz->nLinhas, e, n, 1);
+    distribuirEntradas(e, ord, n, mz->nSuspeitos, 0);
+    montarListasIds(&ix->pistasDoSuspeito, mz->nSuspeitos, ord, n, 0);
+    ix->nAssociacoes = n;
+    free(e);
+    free(ord);
+}
+
+static void liberarListasIds(ListasIds *l) {
+    free(l->tamanho);
+    free(l->primeiroBloco);
+    free(l->idInicial);
+    free(l->inicioBloco);
+    free(l->bytes);
+    memset(l, 0, sizeof(*l));
+}
+
+void liberarIndiceAssociacoes() {
+    liberarListasIds(&indiceAssociacoes.suspeitosDaPista);
+    liberarListasIds(&indiceAssociacoes.pistasDoSuspeito);
+    indiceAssociacoes.nAssociacoes = 0;
+}
+
+/*
+ catalogarPistas(m):
+ - refaz o catálogo com as pistas das salas de m (as associações pista ->
+   suspeito já devem estar carregadas), a matriz de evidências e o índice
+   pista <-> suspeito. Invalida os bitsets e os pontos das sessões.
+*/
+void catalogarPistas(const Mansao *m) {
+    CatalogoPistas *c = &catalogoPistas;
+    size_t nSalas;
+    uint32_t *esq, *dir;
+    Sala **salas = listarSalasParaGravar(m, &nSalas, &esq, &dir);
+    free(esq); free(dir);
+    for (uint32_t i = 0; i < c->quantidade; i++) c->denso[c->pistas[i]] = PISTA_FORA_DO_CATALOGO;
+    c->quantidade = 0;
+    crescerCatalogo(c, (uint32_t) nSalas);
+    for (size_t i = 0; i < nSalas; i++) {
+        IdTexto p = salas[i]->pista;
+        if (p == TEXTO_VAZIO || c->denso[p] != PISTA_FORA_DO_CATALOGO) continue;
+        c->denso[p] = 0;
+        c->pistas[c->quantidade++] = p;
+    }
+    free(salas);
+    qsort(c->pistas, c->quantidade, sizeof(IdTexto), compararTextos);
+    c->nMapa = c->quantidade;
+    c->impressao = 1469598103934665603ull;
+    for (uint32_t i = 0; i < c->quantidade; i++) {
+        c->denso[c->pistas[i]] = i;
+        c->suspeitos[i] = encontrarSuspeitoId(c->pistas[i]);
+        for (const unsigned char *t = (const unsigned char*) textoDe(c->pistas[i]); ; t++) {
+            c->impressao = (c->impressao ^ *t) * 1099511628211ull;
+            if (!*t) break;   // o '\0' separa os textos
+        }
+    }
+    montarMatrizEvidencias();
+    montarIndiceAssociacoes();
+}
+
+// Id denso da pista, acrescentando-a ao catálogo se ela não estiver lá.
+uint32_t idDensoPista(IdTexto pista) {
+    CatalogoPistas *c = &catalogoPistas;
+    if (pista < c->nDenso && c->denso[pista] != PISTA_FORA_DO_CATALOGO) return c->denso[pista];
+    crescerCatalogo(c, c->quantidade + 1);
+    uint32_t d = c->quantidade++;
+    c->pistas[d] = pista;
+    c->suspeitos[d] = encontrarSuspeitoId(pista);
+    c->denso[pista] = d;
+    return d;
+}
+
+void liberarCatalogoPistas() {
+    free(catalogoPistas.pistas);
+    free(catalogoPistas.suspeitos);
+    free(catalogoPistas.denso);
+    memset(&catalogoPistas, 0, sizeof(catalogoPistas));
+    liberarMatrizEvidencias();
+    liberarIndiceAssociacoes();
+}
+
+// ---------------------- PONTUAÇÃO DE EVIDÊNCIAS ----------------------
+
+// Soma de n pesos em destino (linhas densas da matriz). Vetorizada à mão: em
+// -O2 o compilador não vetoriza o laço sem saber que as áreas não se sobrepõem.
+typedef void (*FuncaoSomaPesos)(float *destino, const float *pesos, size_t n);
+
+static void somarPesosEscalar(float *destino, const float *pesos, size_t n) {
+    for (size_t i = 0; i < n; i++) destino[i] += pesos[i];
+}
+
+#if defined(__x86_64__)
+// SSE2 faz parte do x86-64: 4 floats por instrução em qualquer CPU.
+static void somarPesosSse(float *destino, const float *pesos, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(destino + i, _mm_add_ps(_mm_loadu_ps(destino + i), _mm_loadu_ps(pesos + i)));
+    somarPesosEscalar(destino + i, pesos + i, n - i);
+}
+
+// AVX2: 8 floats por instrução, duas somas independentes por volta.
+__attribute__((target("avx2")))
+static void somarPesosAvx2(float *destino, const float *pesos, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_add_ps(_mm256_loadu_ps(destino + i), _mm256_loadu_ps(pesos + i));
+        __m256 b = _mm256_add_ps(_mm256_loadu_ps(destino + i + 8), _mm256_loadu_ps(pesos + i + 8));
+        _mm256_storeu_ps(destino + i, a);
+        _mm256_storeu_ps(destino + i + 8, b);
+    }
+    if (i + 8 <= n) {
+        _mm256_storeu_ps(destino + i, _mm256_add_ps(_mm256_loadu_ps(destino + i), _mm256_loadu_ps(pesos + i)));
+        i += 8;
+    }
+    somarPesosEscalar(destino + i, pesos + i, n - i);
+}
+#endif
+
+// Escolhe a implementação pela CPU em que o programa está rodando.
+static FuncaoSomaPesos escolherSomaPesos(void) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return somarPesosAvx2;
+    return somarPesosSse;
+#else
+    return somarPesosEscalar;
+#endif
+}
+
+// Escolhida na primeira chamada, como hashBytes().
+static _Atomic(FuncaoSomaPesos) somaPesosEscolhida = NULL;
+
+// Nome da implementação que a CPU usa (para o cabeçalho do benchmark).
+static const char* nomeSomaPesos(void) {
+#if defined(__x86_64__)
+    FuncaoSomaPesos f = escolherSomaPesos();
+    return f == somarPesosAvx2 ? "avx2" : "sse";
+#else
+    return "escalar";
+#endif
+}
+
+static void somarPesos(float *destino, const float *pesos, size_t n) {
+    FuncaoSomaPesos f = atomic_load_explicit(&somaPesosEscolhida, memory_order_relaxed);
+    if (!f) {
+        f = escolherSomaPesos();
+        atomic_store_explicit(&somaPesosEscolhida, f, memory_order_relaxed);
+    }
+    f(destino, pesos, n);
+}
+
+// Garante pontos (e o bitset de blocos) para n suspeitos na sessão.
+static void crescerPontos(Sessao *s, size_t n) {
+    size_t novo = s->nPontos ? s->nPontos : 64 * PONTOS_POR_BLOCO;   // sempre múltiplo de 64 blocos
+    while (novo < n) novo *= 2;
+    size_t palavras = novo / PONTOS_POR_BLOCO / 64, palavrasAntes = s->nPontos / PONTOS_POR_BLOCO / 64;
+    s->pontos = (float*) realloc(s->pontos, novo * sizeof(float));
+    s->blocosTocados = (uint64_t*) realloc(s->blocosTocados, palavras * sizeof(uint64_t));
+    s->blocosUsados = (uint32_t*) realloc(s->blocosUsados, novo / PONTOS_POR_BLOCO * sizeof(uint32_t));
+    if (!s->pontos || !s->blocosTocados || !s->blocosUsados) { perror("malloc"); exit(1); }
+    memset(s->pontos + s->nPontos, 0, (novo - s->nPontos) * sizeof(float));
+    memset(s->blocosTocados + palavrasAntes, 0, (palavras - palavrasAntes) * sizeof(uint64_t));
+    s->nPontos = novo;
+}
+
+// Registra o bloco b de pontos como tocado (para reiniciarSessao()).
+static void tocarBloco(Sessao *s, uint32_t b) {
+    uint64_t bit = 1ull << (b % 64);
+    if (s->blocosTocados[b / 64] & bit) return;
+    s->blocosTocados[b / 64] |= bit;
+    s->blocosUsados[s->nBlocosUsados++] = b;
+}
+
+/*
+ somarEvidencias(s, d):
+ - soma aos pontos da sessão os pesos da pista de id denso d (chamada uma vez,
+   quando a pista é coletada pela primeira vez).
+ - linha densa: uma soma vetorial sobre a faixa; esparsa: um acesso por peso.
+ - pistas acrescentadas ao catálogo depois da carga não têm linha: pesam só
+   sobre o suspeito principal (pesoAssociacao()).
+*/
+void somarEvidencias(Sessao *s, uint32_t d) {
+    const MatrizEvidencias *mz = &matrizEvidencias;
+    if (d >= mz->nLinhas) {
+        IdTexto sus = catalogoPistas.suspeitos[d];
+        if (sus == TEXTO_NENHUM) return;
+        uint32_t c = idDensoSuspeito(sus);
+        if (c >= s->nPontos) crescerPontos(s, (size_t) c + 1);
+        tocarBloco(s, c / PONTOS_POR_BLOCO);
+        s->pontos[c] += pesoAssociacao(catalogoPistas.pistas[d], sus);
+        return;
+    }
+    uint32_t ini = mz->inicioLinha[d], fim = mz->inicioLinha[d + 1];
+    if (ini == fim) return;
+    if (mz->nSuspeitos > s->nPontos) crescerPontos(s, mz->nSuspeitos);
+    uint32_t base = mz->baseDensa[d];
+    const uint32_t *colunas = mz->colunas;
+    const float *pesos = mz->pesos;
+    if (base != LINHA_ESPARSA) {
+        for (uint32_t b = base / PONTOS_POR_BLOCO; b <= (base + (fim - ini) - 1) / PONTOS_POR_BLOCO; b++)
+            tocarBloco(s, b);
+        somarPesos(s->pontos + base, pesos + ini, fim - ini);
+        return;
+    }
+    for (uint32_t k = ini; k < fim; k++) {
+        uint32_t c = colunas[k];
+        tocarBloco(s, c / PONTOS_POR_BLOCO);
+        s->pontos[c] += pesos[k];
+    }
+}
+
+// Pontuação do suspeito na sessão (0 se nenhuma pista coletada pesa sobre ele). O(1).
+float pontuacaoSuspeito(const Sessao *s, IdTexto suspeito) {
+    uint32_t c = idSuspeitoMatriz(suspeito);
+    return c < s->nPontos ? s->pontos[c] : 0.0f;
+}
+
+// e^x para x <= 0 sem a libm (o jogo é compilado sem -lm): redução por ln 2 e
+// série de Taylor até r^12 (coeficientes 1/i!, sem divisões); erro relativo
+// abaixo de 1e-13.
+static double expNaoPositivo(double x) {
+    static const double inversoFatorial[13] = {
+        1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320,
+        1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600
+    };
+    if (x < -708.0) return 0.0;
+    int k = (int)(x * 1.4426950408889634 - 0.5);   // x / ln 2 arredondado (x <= 0)
+    double r = x - k * 0.6931471805599453, p = inversoFatorial[12];   // |r| <= ln(2) / 2
+    for (int i = 11; i >= 0; i--) p = p * r + inversoFatorial[i];
+    uint64_t bits = (uint64_t)(k + 1023) << 52;        // 2^k
+    double escala;
+    memcpy(&escala, &bits, sizeof(escala));
+    return p * escala;
+}
+
+/*
+ compararComRivais(s, suspeito, rival, probabilidade):
+ - rival recebe a maior pontuação entre os outros suspeitos da matriz (0 se
+   algum deles não tem pontos, ou se não há outros).
+ - probabilidade (opcional) recebe a do suspeito pelo softmax das pontuações,
+   lidas como log-verossimilhanças com prior uniforme sobre os suspeitos da
+   matriz; 0 se o suspeito não está nela.
+ - só percorre os blocos tocados na sessão (os demais suspeitos têm 0):
+   O(pesos coletados), não O(suspeitos).
+*/
+void compararComRivais(const Sessao *s, IdTexto suspeito, float *rival, double *probabilidade) {
+    const MatrizEvidencias *mz = &matrizEvidencias;
+    uint32_t alvo = idSuspeitoMatriz(suspeito);
+    size_t cobertos = 0, alvoCoberto = 0;
+    int temRival = 0;
+    float melhor = 0.0f;
+    for (size_t i = 0; i < s->nBlocosUsados; i++) {
+        uint32_t c = s->blocosUsados[i] * PONTOS_POR_BLOCO, fim = c + PONTOS_POR_BLOCO;
+        if (fim > mz->nSuspeitos) fim = mz->nSuspeitos;
+        for (; c < fim; c++) {
+            cobertos++;
+            if (c == alvo) { alvoCoberto = 1; continue; }
+            if (!temRival || s->pontos[c] > melhor) melhor = s->pontos[c];
+            temRival = 1;
+        }
+    }
+    size_t outros = mz->nSuspeitos - (alvo != SUSPEITO_FORA_DA_MATRIZ);
+    if (cobertos - alvoCoberto < outros && (!temRival || melhor < 0.0f)) melhor = 0.0f;
+    *rival = melhor;
+    if (!probabilidade) return;
+    if (alvo == SUSPEITO_FORA_DA_MATRIZ) { *probabilidade = 0.0; return; }
+
+    double proprio = alvo < s->nPontos ? s->pontos[alvo] : 0.0f;
+    double maximo = outros && melhor > proprio ? melhor : proprio;
+    double soma = 0.0;
+    if (cobertos < mz->nSuspeitos) soma = (double)(mz->nSuspeitos - cobertos) * expNaoPositivo(-maximo);
+    for (size_t i = 0; i < s->nBlocosUsados; i++) {
+        uint32_t c = s->blocosUsados[i] * PONTOS_POR_BLOCO, fim = c + PONTOS_POR_BLOCO;
+        if (fim > mz->nSuspeitos) fim = mz->nSuspeitos;
+        for (; c < fim; c++) soma += expNaoPositivo(s->pontos[c] - maximo);
+    }
+    *probabilidade = expNaoPositivo(proprio - maximo) / soma;
+}
+
+// ---------------------- BST DE PISTAS ----------------------
+
+// Cria nó de pista (na arena da sessão)
+PistaNode* criarPistaNode(Sessao *s, IdTexto pista) {
+    PistaNode *p = (PistaNode*) arenaAlocar(&s->arena, sizeof(PistaNode));
+    p->pista = pista;
+    p->altura = 1;
+    p->esquerda = p->direita = NULL;
+    return p;
+}
+
+static int alturaPista(PistaNode *n) {
+    return n ? n->altura : 0;
+}
+
+static void atualizarAltura(PistaNode *n) {
+    int he = alturaPista(n->esquerda), hd = alturaPista(n->direita);
+    n->altura = 1 + (he > hd ? he : hd);
+}
+
+static PistaNode* rotacionarDireita(PistaNode *y) {
+    PistaNode *x = y->esquerda;
+    y->esquerda = x->direita;
+    x->direita = y;
+    atualizarAltura(y);
+    atualizarAltura(x);
+    return x;
+}
+
+static PistaNode* rotacionarEsquerda(PistaNode *x) {
+    PistaNode *y = x->direita;
+    x->direita = y->esquerda;
+    y->esquerda = x;
+    atualizarAltura(x);
+    atualizarAltura(y);
+    return y;
+}
+
+// Restaura o balanceamento AVL do nó após uma inserção em uma das subárvores.
+static PistaNode* balancearPista(PistaNode *n) {
+    atualizarAltura(n);
+    int fator = alturaPista(n->esquerda) - alturaPista(n->direita);
+    if (fator > 1) {
+        if (alturaPista(n->esquerda->esquerda) < alturaPista(n->esquerda->direita))
+            n->esquerda = rotacionarEsquerda(n->esquerda);
+        return rotacionarDireita(n);
+    }
+    if (fator < -1) {
+        if (alturaPista(n->direita->direita) < alturaPista(n->direita->esquerda))
+            n->direita = rotacionarDireita(n->direita);
+        return rotacionarEsquerda(n);
+    }
+    return n;
+}
+
+// Insere nova pista na BST (alfabética).
+// Função exigida: inserirPista() / adicionarPista()
+/*
+ inserirPistaId(s, raiz, pista, coletadaFlag):
+ - s: sessão dona dos nós (de onde sai a memória).
+ - raiz: ponteiro para raiz atual da BST.
+ - pista: id do texto da pista a inserir.
+ - coletadaFlag (ponteiro int): recebe 1 se a pista foi inserida, 0 se já existia.
+ - retorna nova raiz (a árvore é rebalanceada como AVL, então a raiz pode mudar).
+ - Não insere duplicatas: ids iguais são a mesma pista, sem strcmp; a ordem
+   alfabética só é consultada para decidir o lado da descida.
+ - Como a altura é O(log n), a recursão é rasa mesmo com pistas chegando em ordem.
+*/
+PistaNode* inserirPistaId(Sessao *s, PistaNode *raiz, IdTexto pista, int *coletadaFlag) {
+    if (raiz == NULL) {
+        if (coletadaFlag) *coletadaFlag = 1;
+        return criarPistaNode(s, pista);
+    }
+    if (pista == raiz->pista) {
+        // mesma pista, não inserir duplicata
+        if (coletadaFlag) *coletadaFlag = 0;
+        return raiz;
+    }
+    if (strcmp(textoDe(pista), textoDe(raiz->pista)) < 0)
+        raiz->esquerda = inserirPistaId(s, raiz->esquerda, pista, coletadaFlag);
+    else
+        raiz->direita = inserirPistaId(s, raiz->direita, pista, coletadaFlag);
+    return balancearPista(raiz);
+}
+
+// 1 se a pista já está na BST (busca pela ordem alfabética, O(log n)).
+int pistaColetada(const PistaNode *raiz, IdTexto pista) {
+    const char *texto = textoDe(pista);
+    while (raiz) {
+        if (raiz->pista == pista) return 1;
+        raiz = strcmp(texto, textoDe(raiz->pista)) < 0 ? raiz->esquerda : raiz->direita;
+    }
+    return 0;
+}
+
+// Monta a AVL já balanceada a partir de pistas em ordem (O(n), sem comparações).
+static PistaNode* montarPistasOrdenadas(Sessao *s, const IdTexto *pistas, size_t n) {
+    if (n == 0) return NULL;
+    size_t meio = n / 2;
+    PistaNode *no = criarPistaNode(s, pistas[meio]);
+    no->esquerda = montarPistasOrdenadas(s, pistas, meio);
+    no->direita = montarPistasOrdenadas(s, pistas + meio + 1, n - meio - 1);
+    atualizarAltura(no);
+    return no;
+}
+
+/*
+ inserirPista(raiz, pista, coletadaFlag):
+ - mesma coisa que inserirPistaId() na sessão do jogo, recebendo a pista como string.
+*/
+PistaNode* inserirPista(PistaNode *raiz, const char *pista, int *coletadaFlag) {
+    raiz = inserirPistaId(&sessaoJogo, raiz, internarTexto(pista), coletadaFlag);
+    METRICA_REGISTRAR(METRICA_ALTURA_PISTAS, raiz->altura);
+    return raiz;
+}
+
+// Exibe pistas (in-order => alfabético), de forma iterativa com pilha explícita.
+void exibirPistas(PistaNode *raiz) {
+    PistaNode *pilha[MAX_ALTURA_AVL];
+    int topo = 0;
+    PistaNode *cur = raiz;
+    while (cur || topo > 0) {
+        while (cur) {
+            pilha[topo++] = cur;
+            cur = cur->esquerda;
+        }
+        cur = pilha[--topo];
+        printf(" - %s\n", textoDe(cur->pista));
+        cur = cur->direita;
+    }
+}
+
+// ---------------------- BUSCA DE PISTAS ----------------------
+
+// Chamado para cada pista encontrada, em ordem alfabética; distancia é a
+// distância de edição até a consulta (0 na busca por prefixo).
+typedef void (*VisitarPista)(void *ctx, IdTexto pista, int distancia);
+
+/*
+ buscarPistasPrefixo(raiz, prefixo, visitar, ctx):
+ - visita as pistas que começam com prefixo, em ordem alfabética.
+ - desce direto até a primeira pista >= prefixo e para na primeira que não
+   começa com ele: O(log n + resultados), sem percorrer a árvore inteira.
+ - retorna o número de pistas visitadas.
+*/
+size_t buscarPistasPrefixo(PistaNode *raiz, const char *prefixo, VisitarPista visitar, void *ctx) {
+    PistaNode *pilha[MAX_ALTURA_AVL];
+    int topo = 0;
+    size_t L = strlen(prefixo), n = 0;
+    PistaNode *cur = raiz;
+    while (cur || topo > 0) {
+        // empilha só os nós >= prefixo: a subárvore esquerda dos menores fica fora do intervalo
+        while (cur) {
+            if (strncmp(textoDe(cur->pista), prefixo, L) < 0) {
+                cur = cur->direita;
+            } else {
+                pilha[topo++] = cur;
+                cur = cur->esquerda;
+            }
+        }
+        if (topo == 0) break;
+        cur = pilha[--topo];
+        const char *texto = textoDe(cur->pista);
+        if (strncmp(texto, prefixo, L) != 0) break;
+        visitar(ctx, cur->pista, 0);
+        n++;
+        cur = cur->direita;
+    }
+    return n;
+}
+
+/*
+ Busca aproximada: distância de Levenshtein <= k.
+ Numa BST, todas as chaves de uma subárvore ficam entre os limites herdados
+ dos ancestrais (inf, sup) e por isso começam com o maior prefixo comum aos
+ dois. As linhas da tabela de distâncias para esse prefixo são calculadas
+ uma vez e reaproveitadas pelos descendentes (o prefixo só cresce ao
+ descer); se o menor valor da última linha passa de k, nenhuma chave da
+ subárvore pode estar a distância <= k e ela é descartada inteira.
+*/
+typedef struct {
+    const char *consulta;
+    size_t m;               // strlen(consulta)
+    int k;
+    int *linhas;            // linhas[j * (m + 1) + i]: distância prefixo[0..j) x consulta[0..i)
+    size_t capLinhas;       // linhas alocadas
+    char *prefixo;          // caracteres que definem as linhas válidas
+    size_t validas;         // linhas 0..validas-1 correspondem a prefixo[0..validas-1)
+    VisitarPista visitar;
+    void *ctx;
+    size_t encontradas;
+} BuscaAproximada;
+
+// Garante a linha j e a calcula a partir da linha j-1 com o caractere c.
+// Retorna o menor valor da linha.
+static int linhaLevenshtein(BuscaAproximada *b, size_t j, char c) {
+    size_t m = b->m;
+    if (j >= b->capLinhas) {
+        size_t cap = b->capLinhas * 2;
+        while (cap <= j) cap *= 2;
+        b->linhas = (int*) realloc(b->linhas, cap * (m + 1) * sizeof(int));
+        b->prefixo = (char*) realloc(b->prefixo, cap);
+        if (!b->linhas || !b->prefixo) { perror("malloc"); exit(1); }
+        b->capLinhas = cap;
+    }
+    const int *ant = b->linhas + (j - 1) * (m + 1);
+    int *lin = b->linhas + j * (m + 1);
+    int menor = lin[0] = (int) j;
+    for (size_t i = 1; i <= m; i++) {
+        int v = ant[i - 1] + (b->consulta[i - 1] != c);
+        if (ant[i] + 1 < v) v = ant[i] + 1;
+        if (lin[i - 1] + 1 < v) v = lin[i - 1] + 1;
+        lin[i] = v;
+        if (v < menor) menor = v;
+    }
+    b->prefixo[j - 1] = c;
+    return menor;
+}
+
+// Estende as linhas válidas até cobrir texto[0..L) e retorna o menor valor
+// da última linha. Para antes (com valor > k) se o limite já foi excedido.
+static int estenderLinhas(BuscaAproximada *b, const char *texto, size_t L) {
+    size_t c = 0;   // linhas 0..c continuam valendo para texto
+    while (c + 1 < b->validas && c < L && b->prefixo[c] == texto[c]) c++;
+    const int *ultima = b->linhas + c * (b->m + 1);
+    int menor = ultima[0];
+    for (size_t i = 1; i <= b->m; i++) if (ultima[i] < menor) menor = ultima[i];
+    for (size_t j = c + 1; j <= L; j++) {
+        menor = linhaLevenshtein(b, j, texto[j - 1]);
+        if (menor > b->k) { b->validas = j + 1; return menor; }
+    }
+    b->validas = L + 1;
+    return menor;
+}
+
+static void buscarAproximadaEm(BuscaAproximada *b, PistaNode *no, const char *inf, const char *sup) {
+    if (!no) return;
+    if (inf && sup) {
+        size_t p = 0;
+        while (inf[p] && inf[p] == sup[p]) p++;
+        if (p > 0 && estenderLinhas(b, inf, p) > b->k) return;  // poda a subárvore inteira
+    }
+    const char *texto = textoDe(no->pista);
+    buscarAproximadaEm(b, no->esquerda, inf, texto);
+    size_t L = strlen(texto);
+    if (estenderLinhas(b, texto, L) <= b->k) {
+        int d = b->linhas[L * (b->m + 1) + b->m];
+        if (d <= b->k) {
+            b->visitar(b->ctx, no->pista, d);
+            b->encontradas++;
+        }
+    }
+    buscarAproximadaEm(b, no->direita, texto, sup);
+}
+
+/*
+ buscarPistasAproximadas(raiz, consulta, k, visitar, ctx):
+ - visita, em ordem alfabética, as pistas a distância de edição (inserção,
+   remoção ou troca de um caractere) <= k da consulta.
+ - retorna o número de pistas visitadas.
+*/
+size_t buscarPistasAproximadas(PistaNode *raiz, const char *consulta, int k, VisitarPista visitar, void *ctx) {
+    BuscaAproximada b;
+    b.consulta = consulta;
+    b.m = strlen(consulta);
+    b.k = k;
+    b.capLinhas = 64;
+    b.linhas = (int*) malloc(b.capLinhas * (b.m + 1) * sizeof(int));
+    b.prefixo = (char*) malloc(b.capLinhas);
+    if (!b.linhas || !b.prefixo) { perror("malloc"); exit(1); }
+    for (size_t i = 0; i <= b.m; i++) b.linhas[i] = (int) i;   // linha 0: prefixo vazio
+    b.validas = 1;
+    b.visitar = visitar;
+    b.ctx = ctx;
+    b.encontradas = 0;
+    buscarAproximadaEm(&b, raiz, NULL, NULL);
+    free(b.linhas);
+    free(b.prefixo);
+    return b.encontradas;
+}
+
+// ---------------------- COLETA DE PISTAS ----------------------
+
+// Resultado de entrar em uma sala
+#define SALA_SEM_PISTA 0
+#define PISTA_NOVA 1
+#define PISTA_REPETIDA 2
+
+// Garante espaço no bitset da sessão para a palavra w (e para o catálogo inteiro).
+static void crescerColetadas(Sessao *s, size_t w) {
+    size_t n = ((size_t) catalogoPistas.quantidade + 63) / 64;
+    if (n < w + 1) n = w + 1;
+    if (n < 2 * s->nPalavras) n = 2 * s->nPalavras;
+    s->coletadas = (uint64_t*) realloc(s->coletadas, n * sizeof(uint64_t));
+    s->palavrasUsadas = (uint32_t*) realloc(s->palavrasUsadas, n * sizeof(uint32_t));
+    if (!s->coletadas || !s->palavrasUsadas) { perror("malloc"); exit(1); }
+    memset(s->coletadas + s->nPalavras, 0, (n - s->nPalavras) * sizeof(uint64_t));
+    s->nPalavras = n;
+}
+
+// Liga o bit d; retorna 0 se ele já estava ligado.
+static int marcarColetada(Sessao *s, uint32_t d) {
+    size_t w = d / 64;
+    uint64_t bit = 1ull << (d % 64);
+    if (w >= s->nPalavras) crescerColetadas(s, w);
+    if (s->coletadas[w] & bit) return 0;
+    if (s->coletadas[w] == 0) s->palavrasUsadas[s->nUsadas++] = (uint32_t) w;
+    s->coletadas[w] |= bit;
+    s->nColetadas++;
+    s->visaoAtual = 0;
+    return 1;
+}
+
+// Conta a pista nova d na sessão: contador do suspeito principal e pesos da
+// matriz de evidências. Retorna o suspeito principal (ou TEXTO_NENHUM).
+static IdTexto contarPistaNova(Sessao *s, uint32_t d) {
+    IdTexto sus = catalogoPistas.suspeitos[d];
+    if (sus != TEXTO_NENHUM) incrementarContadorSuspeitoId(s, sus, 1);
+    somarEvidencias(s, d);
+    return sus;
+}
+
+// 1 se a pista já foi coletada na sessão (O(1), sem tocar no catálogo).
+int pistaNaSessao(const Sessao *s, IdTexto pista) {
+    const CatalogoPistas *c = &catalogoPistas;
+    if (pista >= c->nDenso || c->denso[pista] == PISTA_FORA_DO_CATALOGO) return 0;
+    uint32_t d = c->denso[pista];
+    return d / 64 < s->nPalavras && (s->coletadas[d / 64] >> (d % 64)) & 1;
+}
+
+/*
+ coletarPistaId(s, pista, suspeito):
+ - coleta a pista (TEXTO_VAZIO = sala sem pista) no bitset da sessão e, se
+   ela for nova, incrementa o contador do suspeito associado e soma os pesos
+   dela aos pontos dos suspeitos.
+ - suspeito (opcional) recebe o suspeito da pista nova ou TEXTO_NENHUM.
+ - retorna SALA_SEM_PISTA, PISTA_NOVA ou PISTA_REPETIDA.
+ - a visão ordenada não é tocada: pistasOrdenadas() a refaz quando pedida.
+*/
+int coletarPistaId(Sessao *s, IdTexto pista, IdTexto *suspeito) {
+    if (suspeito) *suspeito = TEXTO_NENHUM;
+    if (pista == TEXTO_VAZIO) return SALA_SEM_PISTA;
+    uint32_t d = idDensoPista(pista);
+    if (!marcarColetada(s, d)) return PISTA_REPETIDA;
+    IdTexto sus = contarPistaNova(s, d);
+    if (suspeito) *suspeito = sus;
+    return PISTA_NOVA;
+}
+
+// Coleta a pista da sala ao entrar nela (ver coletarPistaId()).
+int coletarPista(Sessao *s, Sala *sala, IdTexto *suspeito) {
+    return coletarPistaId(s, sala->pista, suspeito);
+}
+
+/*
+ listarPistasColetadas(s, saida):
+ - escreve em saida (espaço para s->nColetadas) as pistas coletadas em ordem
+   alfabética e retorna quantas são.
+ - a varredura do bitset já sai em ordem; só pistas acrescentadas ao catálogo
+   depois da carga do mapa obrigam a ordenar.
+*/
+size_t listarPistasColetadas(const Sessao *s, IdTexto *saida) {
+    size_t n = 0;
+    int foraDeOrdem = 0;
+    for (size_t w = 0; w < s->nPalavras; w++) {
+        for (uint64_t b = s->coletadas[w]; b; b &= b - 1) {
+            uint32_t d = (uint32_t)(w * 64 + (size_t) __builtin_ctzll(b));
+            if (d >= catalogoPistas.nMapa) foraDeOrdem = 1;
+            saida[n++] = catalogoPistas.pistas[d];
+        }
+    }
+    if (foraDeOrdem) qsort(saida, n, sizeof(IdTexto), compararTextos);
+    return n;
+}
+
+/*
+ pistasOrdenadas(s):
+ - retorna a AVL das pistas coletadas (NULL se nenhuma), para exibição e busca.
+ - é refeita só quando houve coleta desde o último pedido: O(n), montada direto
+   da ordem do bitset, sem comparações. A árvore anterior é descartada.
+*/
+PistaNode* pistasOrdenadas(Sessao *s) {
+    if (s->visaoAtual) return s->raizPistas;
+    IdTexto *pistas = (IdTexto*) malloc((s->nColetadas ? s->nColetadas : 1) * sizeof(IdTexto));
+    if (!pistas) { perror("malloc"); exit(1); }
+    size_t n = listarPistasColetadas(s, pistas);
+    arenaReiniciar(&s->arena);
+    s->raizPistas = montarPistasOrdenadas(s, pistas, n);
+    s->visaoAtual = 1;
+    METRICA_REGISTRAR(METRICA_ALTURA_PISTAS, s->raizPistas ? s->raizPistas->altura : 0);
+    free(pistas);
+    return s->raizPistas;
+}
+
+/*
+ pistasEmComum(a, b, visitar, ctx):
+ - visita (em ordem alfabética, distância 0) as pistas coletadas pelas duas
+   sessões e retorna quantas são; visitar pode ser NULL para só contar.
+ - trabalha palavra a palavra (AND + popcount).
+*/
+size_t pistasEmComum(const Sessao *a, const Sessao *b, VisitarPista visitar, void *ctx) {
+    size_t nPalavras = a->nPalavras < b->nPalavras ? a->nPalavras : b->nPalavras, n = 0;
+    for (size_t w = 0; w < nPalavras; w++) {
+        uint64_t comum = a->coletadas[w] & b->coletadas[w];
+        n += (size_t) __builtin_popcountll(comum);
+        if (!visitar) continue;
+        for (; comum; comum &= comum - 1)
+            visitar(ctx, catalogoPistas.pistas[w * 64 + (size_t) __builtin_ctzll(comum)], 0);
+    }
+    return n;
+}
+
+/*
+ unirPistas(destino, origem):
+ - coleta em destino as pistas de origem que ele ainda não tem (contadores
+   e pontos incluídos) e retorna quantas foram acrescentadas.
+*/
+size_t unirPistas(Sessao *destino, const Sessao *origem) {
+    size_t n = 0;
+    for (size_t w = 0; w < origem->nPalavras; w++) {
+        uint64_t novas = origem->coletadas[w] & ~(w < destino->nPalavras ? destino->coletadas[w] : 0);
+        for (; novas; novas &= novas - 1) {
+            uint32_t d = (uint32_t)(w * 64 + (size_t) __builtin_ctzll(novas));
+            marcarColetada(destino, d);
+            contarPistaNova(destino, d);
+            n++;
+        }
+    }
+    return n;
+}
+
+// ---------------------- CONSULTAS PISTA <-> SUSPEITO ----------------------
+
+/*
+ Cursor sobre uma lista do índice, em ordem crescente. avancarAte() acha por
+ busca binária em idInicial o último bloco que começa antes do alvo e só
+ decodifica esse bloco: listas longas são puladas quase inteiras quando a
+ outra ponta da interseção é curta.
+*/
+typedef struct {
+    const ListasIds *l;
+    uint32_t lista;
+    uint32_t bloco, fimBlocos;   // bloco atual; os da lista vão até fimBlocos
+    uint32_t restantes;          // ids do bloco atual ainda não lidos
+    const unsigned char *p;      // próximo byte do bloco atual
+    uint32_t atual;              // id sob o cursor
+} CursorIds;
+
+static void lerBlocoIds(CursorIds *c, uint32_t bloco) {
+    const ListasIds *l = c->l;
+    uint32_t lidos = (bloco - l->primeiroBloco[c->lista]) * IDS_POR_BLOCO;
+    uint32_t nIds = l->tamanho[c->lista] - lidos;
+    c->bloco = bloco;
+    c->restantes = (nIds < IDS_POR_BLOCO ? nIds : IDS_POR_BLOCO) - 1;
+    c->p = l->bytes + l->inicioBloco[bloco];
+    c->atual = l->idInicial[bloco];
+}
+
+// Posiciona o cursor no primeiro id da lista i; retorna 0 se ela está vazia ou não existe.
+static int abrirListaIds(const ListasIds *l, uint32_t i, CursorIds *c) {
+    if (i >= l->nListas || l->tamanho[i] == 0) return 0;
+    c->l = l;
+    c->lista = i;
+    c->fimBlocos = l->primeiroBloco[i + 1];
+    lerBlocoIds(c, l->primeiroBloco[i]);
+    return 1;
+}
+
+// Passa ao id seguinte; retorna 0 no fim da lista.
+static inline int proximoIdLista(CursorIds *c) {
+    if (c->restantes == 0) {
+        if (c->bloco + 1 >= c->fimBlocos) return 0;
+        lerBlocoIds(c, c->bloco + 1);
+        return 1;
+    }
+    uint32_t delta;
+    c->p = lerVarint(c->p, &delta);
+    c->atual += delta;
+    c->restantes--;
+    return 1;
+}
+
+// Posiciona o cursor no primeiro id >= alvo; retorna 0 se não há nenhum.
+static int avancarAte(CursorIds *c, uint32_t alvo) {
+    if (c->atual >= alvo) return 1;
+    const uint32_t *inicial = c->l->idInicial;
+    if (c->bloco + 1 < c->fimBlocos && inicial[c->bloco + 1] <= alvo) {
+        uint32_t lo = c->bloco + 1, hi = c->fimBlocos;   // inicial[lo] <= alvo < inicial[hi]
+        while (hi - lo > 1) {
+            uint32_t meio = lo + (hi - lo) / 2;
+            if (inicial[meio] <= alvo) lo = meio;
+            else hi = meio;
+        }
+        lerBlocoIds(c, lo);
+    }
+    while (c->atual < alvo)
+        if (!proximoIdLista(c)) return 0;
+    return 1;
+}
+
+// Chamado para cada suspeito encontrado, em ordem alfabética.
+typedef void (*VisitarSuspeito)(void *ctx, IdTexto suspeito);
+
+/*
+ suspeitosDaPista(pista, visitar, ctx):
+ - visita os suspeitos sobre os quais a pista pesa (o principal e os de
+   inserirAssociacao()) e retorna quantos são; visitar pode ser NULL.
+ - só pistas das salas do mapa estão no índice.
+*/
+size_t suspeitosDaPista(IdTexto pista, VisitarSuspeito visitar, void *ctx) {
+    const CatalogoPistas *c = &catalogoPistas;
+    const ListasIds *l = &indiceAssociacoes.suspeitosDaPista;
+    CursorIds cur;
+    if (pista >= c->nDenso || !abrirListaIds(l, c->denso[pista], &cur)) return 0;
+    if (visitar) {
+        do visitar(ctx, matrizEvidencias.suspeitos[cur.atual]); while (proximoIdLista(&cur));
+    }
+    return l->tamanho[cur.lista];
+}
+
+/*
+ pistasDoSuspeito(suspeito, visitar, ctx):
+ - visita (em ordem alfabética, distância 0) as pistas do mapa que pesam
+   sobre o suspeito e retorna quantas são; visitar pode ser NULL.
+ - O(pistas do suspeito), sem varrer as associações das outras.
+*/
+size_t pistasDoSuspeito(IdTexto suspeito, VisitarPista visitar, void *ctx) {
+    const ListasIds *l = &indiceAssociacoes.pistasDoSuspeito;
+    CursorIds cur;
+    if (!abrirListaIds(l, idSuspeitoMatriz(suspeito), &cur)) return 0;
+    if (visitar) {
+        do visitar(ctx, catalogoPistas.pistas[cur.atual], 0); while (proximoIdLista(&cur));
+    }
+    return l->tamanho[cur.lista];
+}
+
+static int compararCursoresPorTamanho(const void *a, const void *b) {
+    const CursorIds *x = (const CursorIds*) a, *y = (const CursorIds*) b;
+    uint32_t tx = x->l->tamanho[x->lista], ty = y->l->tamanho[y->lista];
+    return (tx > ty) - (tx < ty);
+}
+
+/*
+ pistasContraTodos(suspeitos, n, visitar, ctx):
+ - visita (em ordem alfabética, distância 0) as pistas que pesam sobre todos
+   os n suspeitos e retorna quantas são; visitar pode ser NULL para só contar.
+ - interseção "leapfrog": o candidato é o maior id visto; cada lista, em
+   rodízio a partir da mais curta, avança até ele, e quando as n param no
+   mesmo id ele é uma resposta. O custo segue a lista mais curta e os saltos,
+   não o tamanho das longas.
+*/
+size_t pistasContraTodos(const IdTexto *suspeitos, size_t n, VisitarPista visitar, void *ctx) {
+    if (n == 0) return 0;
+    CursorIds *cur = (CursorIds*) malloc(n * sizeof(CursorIds));
+    if (!cur) { perror("malloc"); exit(1); }
+    for (size_t j = 0; j < n; j++) {
+        if (!abrirListaIds(&indiceAssociacoes.pistasDoSuspeito, idSuspeitoMatriz(suspeitos[j]), &cur[j])) {
+            free(cur);
+            return 0;
+        }
+    }
+    qsort(cur, n, sizeof(CursorIds), compararCursoresPorTamanho);
+    size_t encontradas = 0, iguais = 0, j = 0;
+    uint32_t alvo = cur[0].atual;
+    for (;;) {
+        if (!avancarAte(&cur[j], alvo)) break;
+        if (cur[j].atual == alvo) {
+            iguais++;
+        } else {
+            alvo = cur[j].atual;
+            iguais = 1;
+        }
+        if (iguais == n) {
+            if (visitar) visitar(ctx, catalogoPistas.pistas[alvo], 0);
+            encontradas++;
+            if (alvo == 0xFFFFFFFFu) break;
+            alvo++;   // a próxima lista do rodízio sai do id já achado
+            iguais = 0;
+        }
+        j = j + 1 < n ? j + 1 : 0;
+    }
+    free(cur);
+    return encontradas;
+}
+
+typedef struct {
+    FILE *saida;
+    IdTexto suspeito;
+    const Sessao *sessao;   // só as pistas coletadas nela (NULL: todas)
+    size_t escritas;
+} ListagemSuspeito;
+
+static void escreverPistaDoSuspeito(void *ctx, IdTexto pista, int distancia) {
+    ListagemSuspeito *ls = (ListagemSuspeito*) ctx;
+    (void) distancia;
+    if (ls->sessao && !pistaNaSessao(ls->sessao, pista)) return;
+    if (ls->escritas++ == 0) fprintf(ls->saida, "%s\n", textoDe(ls->suspeito));
+    fprintf(ls->saida, " - %s (peso %g)\n", textoDe(pista), (double) pesoAssociacao(pista, ls->suspeito));
+}
+
+/*
+ listarSuspeitosEPistas(saida, s):
+ - escreve cada suspeito, em ordem alfabética, seguido das pistas que pesam
+   sobre ele e do peso de cada uma. Com s, só as pistas coletadas na sessão;
+   suspeitos sem nenhuma pista listada ficam de fora.
+ - retorna o número de suspeitos escritos.
+*/
+size_t listarSuspeitosEPistas(FILE *saida, const Sessao *s) {
+    ListagemSuspeito ls;
+    size_t n = 0;
+    ls.saida = saida;
+    ls.sessao = s;
+    for (uint32_t i = 0; i < matrizEvidencias.nSuspeitos; i++) {
+        ls.suspeito = matrizEvidencias.suspeitos[i];
+        ls.escritas = 0;
+        pistasDoSuspeito(ls.suspeito, escreverPistaDoSuspeito, &ls);
+        n += ls.escritas > 0;
+    }
+    return n;
+}
+
+// ---------------------- PERSISTÊNCIA DA SESSÃO ----------------------
+
+/*
+ Uma investigação em andamento pode ser gravada e retomada:
+ - snapshot (<base>.dqs): cabeçalho + o bitset da sessão sobre as pistas do
+   mapa no catálogo (ids densos em ordem alfabética). Bit i = pista i
+   coletada. Os contadores de suspeitos não são gravados: saem das pistas.
+ - jornal (<base>.dqj): um registro de 8 bytes por movimento (sala de
+   destino + verificação), acrescentado e sincronizado a cada passo. Uma
+   queda perde no máximo o movimento que estava sendo gravado; um registro
+   incompleto ou corrompido no fim é ignorado.
+ Entrar numa sala é idempotente para as pistas, então reaplicar um jornal já
+ incorporado ao snapshot não muda o estado: o snapshot é gravado (arquivo
+ temporário + rename) antes de o jornal ser zerado.
+ Salas são numeradas como em compilarGrafo() (ordem do bloco ou BFS).
+*/
+#define SESSAO_MAGICO "DQS1"
+
+typedef struct {
+    char magico[4];
+    uint32_t nPistasMapa;   // bits do bitset
+    uint64_t impressao;     // identifica as pistas do mapa (CatalogoPistas.impressao)
+    uint32_t salaAtual;
+    uint32_t nColetadas;
+} CabecalhoSessao;
+
+typedef struct {
+    uint32_t sala;
+    uint32_t verificacao;
+} RegistroJornal;
+
+/*
+ salvarSessao(arquivo, s, salaAtual):
+ - grava o snapshot da sessão: o bitset dela restrito às pistas do mapa no
+   catálogo (pistas acrescentadas depois da carga são ignoradas).
+ - retorna o tamanho do arquivo em bytes.
+*/
+size_t salvarSessao(const char *arquivo, const Sessao *s, uint32_t salaAtual) {
+    const CatalogoPistas *c = &catalogoPistas;
+    size_t nPalavras = ((size_t) c->nMapa + 63) / 64;
+    uint64_t *bits = (uint64_t*) calloc(nPalavras ? nPalavras : 1, sizeof(uint64_t));
+    if (!bits) { perror("malloc"); exit(1); }
+    memcpy(bits, s->coletadas, (nPalavras < s->nPalavras ? nPalavras : s->nPalavras) * sizeof(uint64_t));
+    if (c->nMapa % 64) bits[nPalavras - 1] &= (1ull << (c->nMapa % 64)) - 1;
+    CabecalhoSessao cab;
+    memcpy(cab.magico, SESSAO_MAGICO, 4);
+    cab.nPistasMapa = c->nMapa;
+    cab.impressao = c->impressao;
+    cab.salaAtual = salaAtual;
+    cab.nColetadas = 0;
+    for (size_t w = 0; w < nPalavras; w++) cab.nColetadas += (uint32_t) __builtin_popcountll(bits[w]);
+
+    size_t L = strlen(arquivo);
+    char *tmp = (char*) malloc(L + 5);
+    if (!tmp) { perror("malloc"); exit(1); }
+    memcpy(tmp, arquivo, L);
+    memcpy(tmp + L, ".tmp", 5);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) { perror(tmp); exit(1); }
+    if (fwrite(&cab, sizeof(cab), 1, f) != 1 ||
+        fwrite(bits, sizeof(uint64_t), nPalavras, f) != nPalavras ||
+        fflush(f) != 0 || fsync(fileno(f)) != 0 || fclose(f) != 0) { perror(tmp); exit(1); }
+    if (rename(tmp, arquivo) != 0) { perror(arquivo); exit(1); }
+    free(tmp);
+    free(bits);
+    return sizeof(cab) + nPalavras * sizeof(uint64_t);
+}
+
+/*
+ restaurarSessao(arquivo, s, salaAtual):
+ - substitui o estado da sessão pelo do snapshot; retorna 0 se o arquivo
+   não existe, 1 se restaurou (snapshot inválido ou de outro mapa encerra).
+ - o bitset do arquivo é o da sessão: basta lê-lo e recompor os contadores
+   pelo suspeito de cada pista no catálogo.
+*/
+int restaurarSessao(const char *arquivo, Sessao *s, uint32_t *salaAtual) {
+    const CatalogoPistas *c = &catalogoPistas;
+    FILE *f = fopen(arquivo, "rb");
+    if (!f) return 0;
+    CabecalhoSessao cab;
+    if (fread(&cab, sizeof(cab), 1, f) != 1 || memcmp(cab.magico, SESSAO_MAGICO, 4) != 0)
+        erroMapa(arquivo, 0, "snapshot de sessão inválido");
+    if (cab.nPistasMapa != c->nMapa || cab.impressao != c->impressao)
+        erroMapa(arquivo, 0, "snapshot gravado com outro mapa");
+    size_t nPalavras = ((size_t) cab.nPistasMapa + 63) / 64;
+    reiniciarSessao(s);
+    if (nPalavras > s->nPalavras) crescerColetadas(s, nPalavras - 1);
+    if (fread(s->coletadas, sizeof(uint64_t), nPalavras, f) != nPalavras) erroMapa(arquivo, 0, "snapshot truncado");
+    fclose(f);
+    if (c->nMapa % 64 && s->coletadas[nPalavras - 1] >> (c->nMapa % 64))
+        erroMapa(arquivo, 0, "snapshot corrompido");
+
+    for (size_t w = 0; w < nPalavras; w++) {
+        if (s->coletadas[w] == 0) continue;
+        s->palavrasUsadas[s->nUsadas++] = (uint32_t) w;
+        for (uint64_t b = s->coletadas[w]; b; b &= b - 1) {
+            contarPistaNova(s, (uint32_t)(w * 64 + (size_t) __builtin_ctzll(b)));
+            s->nColetadas++;
+        }
+    }
+    if (s->nColetadas != cab.nColetadas) erroMapa(arquivo, 0, "snapshot corrompido");
+    s->visaoAtual = s->nColetadas == 0;
+    *salaAtual = cab.salaAtual;
+    return 1;
+}
+
+static uint32_t verificacaoJornal(uint32_t sala) {
+    return (sala * 0x9E3779B1u) ^ 0x4A4F524Eu;
+}
+
+// Acrescenta um movimento ao jornal e o leva ao disco antes de retornar.
+void registrarMovimento(int fd, uint32_t sala) {
+    RegistroJornal r = { sala, verificacaoJornal(sala) };
+    if (write(fd, &r, sizeof(r)) != (ssize_t) sizeof(r) || fdatasync(fd) != 0) { perror("jornal"); exit(1); }
+}
+
+/*
+ reaplicarJornal(arquivo, s, pistasSalas, nSalas, salaAtual):
+ - entra, em ordem, em cada sala registrada (coletando as pistas) e deixa
+   *salaAtual na última; para no primeiro registro incompleto ou inválido.
+ - retorna o número de movimentos reaplicados.
+*/
+size_t reaplicarJornal(const char *arquivo, Sessao *s, const IdTexto *pistasSalas, size_t nSalas, uint32_t *salaAtual) {
+    FILE *f = fopen(arquivo, "rb");
+    if (!f) return 0;
+    RegistroJornal r;
+    size_t n = 0;
+    while (fread(&r, sizeof(r), 1, f) == 1) {
+        if (r.verificacao != verificacaoJornal(r.sala) || r.sala >= nSalas) break;
+        coletarPistaId(s, pistasSalas[r.sala], NULL);
+        *salaAtual = r.sala;
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+// Persistência da partida interativa (ativada com --sessao <base>).
+typedef struct {
+    int ativa;
+    const Mansao *mansao;
+    Sala **salas;            // índice -> sala
+    IdTexto *pistasSalas;
+    size_t nSalas;
+    char *arquivoSessao;
+    char *arquivoJornal;
+    int fdJornal;
+    uint32_t salaAtual;
+} PersistenciaSessao;
+
+PersistenciaSessao persistenciaJogo;
+
+static char* juntarNome(const char *base, const char *extensao) {
+    size_t a = strlen(base), b = strlen(extensao);
+    char *s = (char*) malloc(a + b + 1);
+    if (!s) { perror("malloc"); exit(1); }
+    memcpy(s, base, a);
+    memcpy(s + a, extensao, b + 1);
+    return s;
+}
+
+/*
+ ativarPersistencia(m, base):
+ - restaura a sessão do jogo a partir de <base>.dqs e <base>.dqj, se
+   existirem, e passa a registrar cada movimento no jornal.
+ - retorna o índice da sala onde a exploração deve continuar.
+ - o catálogo de pistas precisa ser o de m (catalogarPistas()).
+*/
+uint32_t ativarPersistencia(const Mansao *m, const char *base) {
+    PersistenciaSessao *p = &persistenciaJogo;
+    uint32_t *esq, *dir;
+    p->mansao = m;
+    p->salas = listarSalasParaGravar(m, &p->nSalas, &esq, &dir);
+    free(esq); free(dir);
+    p->pistasSalas = (IdTexto*) malloc((p->nSalas ? p->nSalas : 1) * sizeof(IdTexto));
+    if (!p->pistasSalas) { perror("malloc"); exit(1); }
+    for (size_t i = 0; i < p->nSalas; i++) p->pistasSalas[i] = p->salas[i]->pista;
+    p->arquivoSessao = juntarNome(base, ".dqs");
+    p->arquivoJornal = juntarNome(base, ".dqj");
+
+    p->salaAtual = 0;
+    int restaurou = restaurarSessao(p->arquivoSessao, &sessaoJogo, &p->salaAtual);
+    size_t movimentos = reaplicarJornal(p->arquivoJornal, &sessaoJogo, p->pistasSalas, p->nSalas, &p->salaAtual);
+    if (p->salaAtual >= p->nSalas) p->salaAtual = 0;
+    if (restaurou || movimentos)
+        printf("Sessão retomada de %s (%zu movimento(s) do jornal).\n", base, movimentos);
+
+    p->fdJornal = open(p->arquivoJornal, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (p->fdJornal < 0) { perror(p->arquivoJornal); exit(1); }
+    p->ativa = 1;
+    registrarMovimento(p->fdJornal, p->salaAtual);   // a sala de partida também conta: a pista dela é coletada ao entrar
+    return p->salaAtual;
+}
+
+// Índice da sala na numeração da persistência.
+static uint32_t indiceDaSala(const Sala *sala) {
+    const PersistenciaSessao *p = &persistenciaJogo;
+    if (p->mansao->bloco) return (uint32_t)(sala - p->mansao->bloco);
+    for (size_t i = 0; i < p->nSalas; i++)
+        if (p->salas[i] == sala) return (uint32_t) i;
+    return 0;
+}
+
+// Registra a entrada do jogador numa sala (sem efeito se a persistência está desligada).
+void anotarMovimento(uint32_t sala) {
+    if (!persistenciaJogo.ativa) return;
+    persistenciaJogo.salaAtual = sala;
+    registrarMovimento(persistenciaJogo.fdJornal, sala);
+}
+
+void anotarMovimentoSala(const Sala *sala) {
+    if (persistenciaJogo.ativa) anotarMovimento(indiceDaSala(sala));
+}
+
+// Grava o snapshot, zera o jornal e libera a persistência.
+void encerrarPersistencia() {
+    PersistenciaSessao *p = &persistenciaJogo;
+    if (!p->ativa) return;
+    salvarSessao(p->arquivoSessao, &sessaoJogo, p->salaAtual);
+    if (ftruncate(p->fdJornal, 0) != 0) { perror(p->arquivoJornal); exit(1); }
+    close(p->fdJornal);
+    free(p->salas);
+    free(p->pistasSalas);
+    free(p->arquivoSessao);
+    free(p->arquivoJornal);
+    memset(p, 0, sizeof(*p));
+}
+
+// ---------------------- EXPLORAÇÃO DA MANSÃO ----------------------
+
+#define TOLERANCIA_BUSCA 2   // erros de digitação aceitos na busca interativa
+
+static void imprimirPistaEncontrada(void *ctx, IdTexto pista, int distancia) {
+    (void) ctx;
+    if (distancia) printf(" - %s (%d diferença(s))\n", textoDe(pista), distancia);
+    else printf(" - %s\n", textoDe(pista));
+}
+
+/*
+ buscarPistasInterativo(raiz):
+ - lê uma consulta; "texto*" lista as pistas que começam com texto, sem o
+   asterisco aceita até TOLERANCIA_BUSCA erros de digitação.
+*/
+void buscarPistasInterativo(PistaNode *raiz) {
+    char consulta[MAX_PISTA];
+    int c; while ((c=getchar()) != '\n' && c != EOF);
+    printf("Buscar pista (termine com * para buscar por prefixo): ");
+    if (fgets(consulta, sizeof(consulta), stdin) == NULL) return;
+    size_t L = strlen(consulta);
+    while (L > 0 && (consulta[L-1] == '\n' || consulta[L-1] == '\r')) consulta[--L] = '\0';
+    size_t n;
+    if (L > 0 && consulta[L-1] == '*') {
+        consulta[--L] = '\0';
+        n = buscarPistasPrefixo(raiz, consulta, imprimirPistaEncontrada, NULL);
+    } else {
+        n = buscarPistasAproximadas(raiz, consulta, TOLERANCIA_BUSCA, imprimirPistaEncontrada, NULL);
+    }
+    if (n == 0) printf("Nenhuma pista coletada corresponde à busca.\n");
+}
+
+// Sala alcançada pela escolha ('e' ou 'd', maiúscula ou minúscula), ou NULL se não houver porta.
+Sala* salaVizinha(Sala *atual, char escolha) {
+    if (escolha == 'e' || escolha == 'E') return atual->esquerda;
+    if (escolha == 'd' || escolha == 'D') return atual->direita;
+    return NULL;
+}
+
+// Anuncia a sala em que o jogador entrou e coleta a pista dela na sessão do jogo.
+static void entrarNaSala(IdTexto nome, IdTexto pista) {
+    METRICA_INICIO(inicio);
+    METRICA_SOMAR(METRICA_SALAS_VISITADAS, 1);
+    printf("\nVocê está em: %s\n", textoDe(nome));
+    if (pista != TEXTO_VAZIO) {
+        printf(" -> Pista encontrada: \"%s\"\n", textoDe(pista));
+        // marca a pista no bitset da sessão; se é nova, incrementa o contador do suspeito
+        IdTexto sus;
+        int resultado = coletarPistaId(&sessaoJogo, pista, &sus);
+        METRICA_SOMAR(resultado == PISTA_NOVA ? METRICA_PISTAS_NOVAS : METRICA_PISTAS_REPETIDAS, 1);
+        if (resultado == PISTA_NOVA) {
+            if (sus != TEXTO_NENHUM) {
+                printf("    (a pista aponta para o suspeito: %s)\n", textoDe(sus));
+            } else {
+                printf("    (pista sem associação a suspeitos)\n");
+            }
+        } else {
+            printf("    (pista já coletada anteriormente)\n");
+        }
+    } else {
+        printf(" -> Nenhuma pista neste cômodo.\n");
+    }
+    METRICA_DURACAO(METRICA_ENTRADA_SALA_NS, inicio);
+}
+
+// Função exigida: explorarSalas()
+// Navega a partir da sala atual e coleta pistas automaticamente ao entrar
+// (na sessão do jogo; ao sair, raizPistas recebe a visão ordenada das pistas).
+void explorarSalas(Sala *inicio, PistaNode **raizPistas) {
+    Sala *atual = inicio;
+    char escolha;
+    while (1) {
+        entrarNaSala(atual->nome, atual->pista);
+
+        // opções ao jogador
+        printf("\nEscolhas: (e) esquerda   (d) direita   (b) buscar pistas   (s) sair\nOpção: ");
+        if (scanf(" %c", &escolha) != 1) {
+            // limpar stdin
+            int c; while ((c=getchar()) != '\n' && c != EOF);
+            escolha = 'x';
+        }
+
+        if (escolha == 'e' || escolha == 'E') {
+            if (atual->esquerda) { atual = atual->esquerda; anotarMovimentoSala(atual); }
+            else printf("Não há sala à esquerda.\n");
+        } else if (escolha == 'd' || escolha == 'D') {
+            if (atual->direita) { atual = atual->direita; anotarMovimentoSala(atual); }
+            else printf("Não há sala à direita.\n");
+        } else if (escolha == 'b' || escolha == 'B') {
+            buscarPistasInterativo(pistasOrdenadas(&sessaoJogo));
+        } else if (escolha == 's' || escolha == 'S') {
+            printf("Exploração encerrada pelo jogador.\n");
+            break;
+        } else {
+            printf("Opção inválida. Tente novamente.\n");
+        }
+    }
+    *raizPistas = pistasOrdenadas(&sessaoJogo);
+}
+
+// ---------------------- GRAFO DA MANSÃO ----------------------
+
+/*
+ Mansões com mais de duas saídas por sala, escadas e ciclos: as salas viram
+ vértices e cada saída (esquerda, direita e as portas do mapa) uma aresta
+ com nome. Adjacência em CSR (compressed sparse row): as saídas da sala i
+ ocupam destinos[inicioSaidas[i] .. inicioSaidas[i+1]), com o nome no mesmo
+ índice de nomesSaidas; as entradas (arestas invertidas, usadas pela busca
+ bidirecional) seguem o mesmo esquema. Nenhum malloc por sala ou por porta.
+*/
+typedef struct {
+    uint32_t nSalas;
+    uint32_t nSaidas;
+    uint32_t *inicioSaidas;    // nSalas + 1
+    uint32_t *destinos;
+    IdTexto *nomesSaidas;
+    uint32_t *inicioEntradas;  // nSalas + 1
+    uint32_t *origens;
+    IdTexto *nomes;            // por sala
+    IdTexto *pistas;
+} GrafoMansao;
+
+// Ordena as arestas por chave (origem ou destino) em CSR: contagem, soma de
+// prefixos e distribuição estável (mantém a ordem das saídas de cada sala).
+static void montarCSR(uint32_t nSalas, const PortaMapa *arestas, size_t nArestas, int porDestino,
+                      uint32_t **inicio, uint32_t **vizinhos, IdTexto **nomesArestas) {
+    *inicio = (uint32_t*) calloc((size_t) nSalas + 1, sizeof(uint32_t));
+    *vizinhos = (uint32_t*) malloc((nArestas ? nArestas : 1) * sizeof(uint32_t));
+    if (nomesArestas) *nomesArestas = (IdTexto*) malloc((nArestas ? nArestas : 1) * sizeof(IdTexto));
+    if (!*inicio || !*vizinhos || (nomesArestas && !*nomesArestas)) { perror("malloc"); exit(1); }
+    uint32_t *ini = *inicio;
+    for (size_t i = 0; i < nArestas; i++)
+        ini[(porDestino ? arestas[i].destino : arestas[i].origem) + 1]++;
+    for (uint32_t i = 0; i < nSalas; i++) ini[i + 1] += ini[i];
+    // ini[s] serve de cursor durante a distribuição e depois é restaurado
+    for (size_t i = 0; i < nArestas; i++) {
+        uint32_t chave = porDestino ? arestas[i].destino : arestas[i].origem;
+        uint32_t j = ini[chave]++;
+        (*vizinhos)[j] = porDestino ? arestas[i].origem : arestas[i].destino;
+        if (nomesArestas) (*nomesArestas)[j] = arestas[i].nome;
+    }
+    for (uint32_t i = nSalas; i > 0; i--) ini[i] = ini[i - 1];
+    ini[0] = 0;
+}
+
+/*
+ montarGrafo(nSalas, nomes, pistas, arestas, nArestas):
+ - monta o grafo a partir de uma lista de arestas (origem, destino, nome).
+ - nomes e pistas (um por sala, malloc) passam a pertencer ao grafo.
+*/
+GrafoMansao montarGrafo(uint32_t nSalas, IdTexto *nomes, IdTexto *pistas, const PortaMapa *arestas, size_t nArestas) {
+    GrafoMansao g;
+    if (nArestas >= MAPA_SEM_SALA) { fprintf(stderr, "portas demais para índices de 32 bits\n"); exit(1); }
+    g.nSalas = nSalas;
+    g.nSaidas = (uint32_t) nArestas;
+    g.nomes = nomes;
+    g.pistas = pistas;
+    montarCSR(nSalas, arestas, nArestas, 0, &g.inicioSaidas, &g.destinos, &g.nomesSaidas);
+    montarCSR(nSalas, arestas, nArestas, 1, &g.inicioEntradas, &g.origens, NULL);
+    return g;
+}
+
+/*
+ compilarGrafo(m):
+ - grafo da mansão: esquerda e direita viram saídas com esses nomes, seguidas
+   das portas do mapa. Com bloco, a sala i do grafo é a sala i do arquivo;
+   sem bloco (mansão padrão), as salas são numeradas em ordem BFS.
+*/
+GrafoMansao compilarGrafo(const Mansao *m) {
+    size_t n;
+    uint32_t *esq, *dir;
+    Sala **salas = listarSalasParaGravar(m, &n, &esq, &dir);
+    if (n >= MAPA_SEM_SALA) { fprintf(stderr, "mapa grande demais para índices de 32 bits\n"); exit(1); }
+    IdTexto *nomes = (IdTexto*) malloc((n ? n : 1) * sizeof(IdTexto));
+    IdTexto *pistas = (IdTexto*) malloc((n ? n : 1) * sizeof(IdTexto));
+    PortaMapa *arestas = (PortaMapa*) malloc((2 * n + m->nPortas + 1) * sizeof(PortaMapa));
+    if (!nomes || !pistas || !arestas) { perror("malloc"); exit(1); }
+    IdTexto nomeEsq = internarTexto("esquerda"), nomeDir = internarTexto("direita");
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) {
+        nomes[i] = salas[i]->nome;
+        pistas[i] = salas[i]->pista;
+        if (esq[i] != MAPA_SEM_SALA) { arestas[k].origem = (uint32_t) i; arestas[k].destino = esq[i]; arestas[k].nome = nomeEsq; k++; }
+        if (dir[i] != MAPA_SEM_SALA) { arestas[k].origem = (uint32_t) i; arestas[k].destino = dir[i]; arestas[k].nome = nomeDir; k++; }
+    }
+    memcpy(arestas + k, m->portas, m->nPortas * sizeof(PortaMapa));
+    k += m->nPortas;
+    GrafoMansao g = montarGrafo((uint32_t) n, nomes, pistas, arestas, k);
+    free(arestas);
+    free(salas); free(esq); free(dir);
+    return g;
+}
+
+void liberarGrafo(GrafoMansao *g) {
+    free(g->inicioSaidas); free(g->destinos); free(g->nomesSaidas);
+    free(g->inicioEntradas); free(g->origens);
+    free(g->nomes); free(g->pistas);
+    memset(g, 0, sizeof(*g));
+}
+
+// Estado de uma busca em largura num sentido. marca[s] == epoca diz que s já
+// foi alcançada nesta busca, o que dispensa zerar os vetores a cada consulta.
+typedef struct {
+    uint32_t *marca;
+    uint32_t *pai;       // sala anterior no caminho (MAPA_SEM_SALA na origem)
+    uint32_t *dist;
+    uint32_t *fila;
+    uint32_t epoca;
+} LadoBusca;
+
+// Memória reutilizável entre consultas ao mesmo grafo (uma por thread).
+typedef struct {
+    LadoBusca ida;      // a partir da origem, pelas saídas
+    LadoBusca volta;    // a partir do destino, pelas entradas
+    uint32_t nSalas;
+} BuscaGrafo;
+
+static void iniciarLado(LadoBusca *l, uint32_t n) {
+    l->marca = (uint32_t*) calloc(n ? n : 1, sizeof(uint32_t));
+    l->pai = (uint32_t*) malloc((n ? n : 1) * sizeof(uint32_t));
+    l->dist = (uint32_t*) malloc((n ? n : 1) * sizeof(uint32_t));
+    l->fila = (uint32_t*) malloc((n ? n : 1) * sizeof(uint32_t));
+    if (!l->marca || !l->pai || !l->dist || !l->fila) { perror("malloc"); exit(1); }
+    l->epoca = 0;
+}
+
+static void novaEpoca(LadoBusca *l, uint32_t n) {
+    if (++l->epoca == 0) {   // deu a volta: zera as marcas uma vez a cada 2^32 buscas
+        memset(l->marca, 0, (size_t) n * sizeof(uint32_t));
+        l->epoca = 1;
+    }
+}
+
+static void alcancar(LadoBusca *l, uint32_t s, uint32_t pai, uint32_t dist) {
+    l->marca[s] = l->epoca;
+    l->pai[s] = pai;
+    l->dist[s] = dist;
+}
+
+void iniciarBuscaGrafo(BuscaGrafo *b, const GrafoMansao *g) {
+    b->nSalas = g->nSalas;
+    iniciarLado(&b->ida, g->nSalas);
+    iniciarLado(&b->volta, g->nSalas);
+}
+
+void liberarBuscaGrafo(BuscaGrafo *b) {
+    LadoBusca *lados[2] = { &b->ida, &b->volta };
+    for (int i = 0; i < 2; i++) {
+        free(lados[i]->marca); free(lados[i]->pai); free(lados[i]->dist); free(lados[i]->fila);
+    }
+}
+
+// Caminho origem -> ... -> s pelos pais da ida e, se comVolta, continuando de
+// s até o destino pelos pais da volta. Retorna vetor malloc.
+static uint32_t* montarCaminho(const BuscaGrafo *b, uint32_t s, int comVolta, size_t *tam) {
+    size_t n = b->ida.dist[s] + 1 + (comVolta ? b->volta.dist[s] : 0);
+    uint32_t *caminho = (uint32_t*) malloc(n * sizeof(uint32_t));
+    if (!caminho) { perror("malloc"); exit(1); }
+    size_t i = b->ida.dist[s];
+    for (uint32_t x = s; x != MAPA_SEM_SALA; x = b->ida.pai[x]) caminho[i--] = x;
+    if (comVolta) {
+        i = b->ida.dist[s] + 1;
+        for (uint32_t x = b->volta.pai[s]; x != MAPA_SEM_SALA; x = b->volta.pai[x]) caminho[i++] = x;
+    }
+    *tam = n;
+    return caminho;
+}
+
+/*
+ buscaEmLargura(g, b, origem, parar, ctx):
+ - BFS pelas saídas a partir da origem; cada sala é visitada uma vez, então
+   ciclos e portas de volta não causam repetição.
+ - se parar (opcional) devolver 1 para uma sala, a busca termina nela e a
+   retorna; senão retorna MAPA_SEM_SALA depois de alcançar tudo.
+ - *alcancadas (opcional) recebe o número de salas alcançadas.
+*/
+typedef int (*PararBusca)(void *ctx, const GrafoMansao *g, uint32_t sala);
+
+uint32_t buscaEmLargura(const GrafoMansao *g, BuscaGrafo *b, uint32_t origem, PararBusca parar, void *ctx, size_t *alcancadas) {
+    LadoBusca *l = &b->ida;
+    novaEpoca(l, g->nSalas);
+    size_t ini = 0, fim = 0;
+    uint32_t achada = MAPA_SEM_SALA;
+    alcancar(l, origem, MAPA_SEM_SALA, 0);
+    l->fila[fim++] = origem;
+    while (ini < fim) {
+        uint32_t u = l->fila[ini++];
+        if (parar && parar(ctx, g, u)) { achada = u; break; }
+        for (uint32_t e = g->inicioSaidas[u]; e < g->inicioSaidas[u + 1]; e++) {
+            uint32_t v = g->destinos[e];
+            if (l->marca[v] == l->epoca) continue;
+            alcancar(l, v, u, l->dist[u] + 1);
+            l->fila[fim++] = v;
+        }
+    }
+    if (alcancadas) *alcancadas = fim;
+    return achada;
+}
+
+static int ehDestino(void *ctx, const GrafoMansao *g, uint32_t sala) {
+    (void) g;
+    return sala == *(const uint32_t*) ctx;
+}
+
+// Menor caminho (em número de portas) por BFS simples; NULL se inalcançável.
+uint32_t* caminhoBFS(const GrafoMansao *g, BuscaGrafo *b, uint32_t origem, uint32_t destino, size_t *tam) {
+    if (buscaEmLargura(g, b, origem, ehDestino, &destino, NULL) == MAPA_SEM_SALA) return NULL;
+    return montarCaminho(b, destino, 0, tam);
+}
+
+// Expande um nível inteiro de um lado; devolve a melhor sala de encontro
+// (menor dist ida + dist volta) entre as descobertas, ou MAPA_SEM_SALA.
+static uint32_t expandirNivel(const uint32_t *inicio, const uint32_t *vizinhos,
+                              LadoBusca *l, const LadoBusca *outro, size_t *ini, size_t *fim, uint32_t *melhor) {
+    uint32_t encontro = MAPA_SEM_SALA;
+    size_t fimNivel = *fim;
+    while (*ini < fimNivel) {
+        uint32_t u = l->fila[(*ini)++];
+        for (uint32_t e = inicio[u]; e < inicio[u + 1]; e++) {
+            uint32_t v = vizinhos[e];
+            if (l->marca[v] == l->epoca) continue;
+            alcancar(l, v, u, l->dist[u] + 1);
+            l->fila[(*fim)++] = v;
+            if (outro->marca[v] == outro->epoca && l->dist[v] + outro->dist[v] < *melhor) {
+                *melhor = l->dist[v] + outro->dist[v];
+                encontro = v;
+            }
+        }
+    }
+    return encontro;
+}
+
+/*
+ caminhoMaisCurto(g, b, origem, destino, tam):
+ - menor caminho por BFS bidirecional: avança um nível por vez do lado com
+   a fronteira menor (ida pelas saídas, volta pelas entradas) até as duas
+   buscas se tocarem; o nível em que se tocam é terminado para escolher o
+   melhor encontro. Visita ~2*b^(d/2) salas em vez de ~b^d.
+ - retorna o vetor de salas origem..destino (malloc, *tam entradas) ou NULL.
+*/
+uint32_t* caminhoMaisCurto(const GrafoMansao *g, BuscaGrafo *b, uint32_t origem, uint32_t destino, size_t *tam) {
+    LadoBusca *ida = &b->ida, *volta = &b->volta;
+    novaEpoca(ida, g->nSalas);
+    novaEpoca(volta, g->nSalas);
+    size_t iniI = 0, fimI = 0, iniV = 0, fimV = 0;
+    alcancar(ida, origem, MAPA_SEM_SALA, 0);
+    ida->fila[fimI++] = origem;
+    alcancar(volta, destino, MAPA_SEM_SALA, 0);
+    volta->fila[fimV++] = destino;
+    if (origem == destino) return montarCaminho(b, origem, 0, tam);
+
+    uint32_t melhor = MAPA_SEM_SALA, encontro = MAPA_SEM_SALA;
+    while (iniI < fimI && iniV < fimV) {
+        uint32_t e;
+        if (fimI - iniI <= fimV - iniV)
+            e = expandirNivel(g->inicioSaidas, g->destinos, ida, volta, &iniI, &fimI, &melhor);
+        else
+            e = expandirNivel(g->inicioEntradas, g->origens, volta, ida, &iniV, &fimV, &melhor);
+        if (e != MAPA_SEM_SALA) encontro = e;
+        if (encontro != MAPA_SEM_SALA) break;
     }
-    return raiz;
+    if (encontro == MAPA_SEM_SALA) return NULL;
+    return montarCaminho(b, encontro, 1, tam);
 }
 
-// Exibe pistas (in-order => alfabético)
-void exibirPistas(PistaNode *raiz) {
-    if (!raiz) return;
-    exibirPistas(raiz->esquerda);
-    printf(" - %s\n", raiz->pista);
-    exibirPistas(raiz->direita);
+static int temPistaNaoColetada(void *ctx, const GrafoMansao *g, uint32_t sala) {
+    const Sessao *s = (const Sessao*) ctx;
+    IdTexto pista = g->pistas[sala];
+    return pista != TEXTO_VAZIO && !pistaNaSessao(s, pista);
 }
 
-// ---------------------- EXPLORAÇÃO DA MANSÃO ----------------------
+// Caminho até a sala mais próxima (em portas) com pista ainda não coletada na sessão.
+uint32_t* caminhoPistaMaisProxima(const GrafoMansao *g, BuscaGrafo *b, const Sessao *s, uint32_t origem, size_t *tam) {
+    uint32_t alvo = buscaEmLargura(g, b, origem, temPistaNaoColetada, (void*) s, NULL);
+    if (alvo == MAPA_SEM_SALA) return NULL;
+    return montarCaminho(b, alvo, 0, tam);
+}
 
-// Função exigida: explorarSalas()
-// Navega a partir da sala atual e coleta pistas automaticamente ao entrar.
-void explorarSalas(Sala *inicio, PistaNode **raizPistas) {
-    Sala *atual = inicio;
-    char escolha;
+// Nome da primeira saída de u que leva a v.
+static IdTexto nomeSaida(const GrafoMansao *g, uint32_t u, uint32_t v) {
+    for (uint32_t e = g->inicioSaidas[u]; e < g->inicioSaidas[u + 1]; e++)
+        if (g->destinos[e] == v) return g->nomesSaidas[e];
+    return TEXTO_NENHUM;
+}
+
+/*
+ explorarGrafo(g, inicio, raizPistas):
+ - exploração interativa como explorarSalas(), para mapas com portas: o
+   jogador escolhe a saída pelo número; (c) mostra o caminho até a pista não
+   coletada mais próxima. Voltar a uma sala já visitada não repete a coleta.
+*/
+void explorarGrafo(const GrafoMansao *g, uint32_t inicio, PistaNode **raizPistas) {
+    BuscaGrafo busca;
+    iniciarBuscaGrafo(&busca, g);
+    uint32_t atual = inicio;
+    char opcao[32];
     while (1) {
-        printf("\nVocê está em: %s\n", atual->nome);
-        if (strlen(atual->pista) > 0) {
-            printf(" -> Pista encontrada: \"%s\"\n", atual->pista);
-            // tenta inserir na BST de pistas; se inseriu (nova), então incrementa contador do suspeito
-            int inseriu = 0;
-            *raizPistas = inserirPista(*raizPistas, atual->pista, &inseriu);
-            if (inseriu) {
-                const char *sus = encontrarSuspeito(atual->pista);
-                if (sus != NULL) {
-                    incrementarContadorSuspeito(sus, 1);
-                    printf("    (a pista aponta para o suspeito: %s)\n", sus);
-                } else {
-                    printf("    (pista sem associação a suspeitos)\n");
-                }
-            } else {
-                printf("    (pista já coletada anteriormente)\n");
-            }
-        } else {
-            printf(" -> Nenhuma pista neste cômodo.\n");
-        }
+        entrarNaSala(g->nomes[atual], g->pistas[atual]);
 
-        // opções ao jogador
-        printf("\nEscolhas: (e) esquerda   (d) direita   (s) sair\nOpção: ");
-        if (scanf(" %c", &escolha) != 1) {
-            // limpar stdin
-            int c; while ((c=getchar()) != '\n' && c != EOF);
-            escolha = 'x';
-        }
+        printf("\nSaídas:\n");
+        uint32_t nSaidas = g->inicioSaidas[atual + 1] - g->inicioSaidas[atual];
+        for (uint32_t i = 0; i < nSaidas; i++)
+            printf("  (%u) %s\n", i + 1, textoDe(g->nomesSaidas[g->inicioSaidas[atual] + i]));
+        if (nSaidas == 0) printf("  (nenhuma)\n");
+        printf("Escolhas: número da saída   (c) caminho até a próxima pista   (b) buscar pistas   (s) sair\nOpção: ");
+        int lidos = scanf(" %31s", opcao);
+        if (lidos == EOF) strcpy(opcao, "s");   // entrada acabou: encerra a exploração
+        else if (lidos != 1) opcao[0] = '\0';
 
-        if (escolha == 'e' || escolha == 'E') {
-            if (atual->esquerda) atual = atual->esquerda;
-            else printf("Não há sala à esquerda.\n");
-        } else if (escolha == 'd' || escolha == 'D') {
-            if (atual->direita) atual = atual->direita;
-            else printf("Não há sala à direita.\n");
-        } else if (escolha == 's' || escolha == 'S') {
+        char *fim;
+        unsigned long k = strtoul(opcao, &fim, 10);
+        if (opcao[0] >= '0' && opcao[0] <= '9' && *fim == '\0') {
+            if (k >= 1 && k <= nSaidas) {
+                atual = g->destinos[g->inicioSaidas[atual] + k - 1];
+                anotarMovimento(atual);
+            } else {
+                printf("Não há saída %lu.\n", k);
+            }
+        } else if (strcmp(opcao, "c") == 0 || strcmp(opcao, "C") == 0) {
+            size_t n;
+            uint32_t *caminho = caminhoPistaMaisProxima(g, &busca, &sessaoJogo, atual, &n);
+            if (!caminho) {
+                printf("Não há pistas por coletar ao alcance.\n");
+            } else {
+                printf("Pista mais próxima em %s (%zu porta(s)):", textoDe(g->nomes[caminho[n - 1]]), n - 1);
+                for (size_t i = 1; i < n; i++)
+                    printf(" %s%s", i > 1 ? "-> " : "", textoDe(nomeSaida(g, caminho[i - 1], caminho[i])));
+                printf("\n");
+                free(caminho);
+            }
+        } else if (strcmp(opcao, "b") == 0 || strcmp(opcao, "B") == 0) {
+            buscarPistasInterativo(pistasOrdenadas(&sessaoJogo));
+        } else if (strcmp(opcao, "s") == 0 || strcmp(opcao, "S") == 0) {
             printf("Exploração encerrada pelo jogador.\n");
             break;
         } else {
             printf("Opção inválida. Tente novamente.\n");
         }
     }
+    *raizPistas = pistasOrdenadas(&sessaoJogo);
+    liberarBuscaGrafo(&busca);
 }
 
 // ---------------------- JULGAMENTO FINAL ----------------------
 
+#define MIN_PISTAS_CULPADO 2
+
+/*
+ Regra de condenação (mestre --regra pontos=P,margem=M,probabilidade=Q):
+ - pontos: pontuação mínima do acusado (soma dos pesos das pistas coletadas).
+ - margem: vantagem mínima sobre o segundo colocado (0 = não exige).
+ - probabilidade: probabilidade mínima do acusado, 0..1 (0 = não exige).
+ O padrão (pontos=2) com as associações sem peso é a regra original: pelo
+ menos 2 pistas apontando para o acusado. Suspeito que nenhuma pista cita
+ nunca é culpado.
+*/
+typedef struct {
+    float minimoPontos;
+    float margem;
+    double probabilidade;
+} RegraCondenacao;
+
+RegraCondenacao regraCondenacao = { MIN_PISTAS_CULPADO, 0.0f, 0.0 };
+
+// Lê "chave=valor,..." sobre a regra atual; retorna 0 se algo não for reconhecido.
+int lerRegraCondenacao(const char *texto, RegraCondenacao *r) {
+    RegraCondenacao lida = *r;
+    const char *p = texto;
+    while (*p) {
+        const char *igual = strchr(p, '=');
+        if (!igual) return 0;
+        char *fim;
+        double v = strtod(igual + 1, &fim);
+        if (fim == igual + 1 || (*fim != ',' && *fim != '\0') || !__builtin_isfinite(v)) return 0;
+        size_t L = (size_t)(igual - p);
+        if (L == 6 && strncmp(p, "pontos", L) == 0) lida.minimoPontos = (float) v;
+        else if (L == 6 && strncmp(p, "margem", L) == 0) lida.margem = (float) v;
+        else if (L == 13 && strncmp(p, "probabilidade", L) == 0 && v <= 1.0) lida.probabilidade = v;
+        else return 0;
+        p = *fim ? fim + 1 : fim;
+    }
+    *r = lida;
+    return 1;
+}
+
+typedef struct {
+    float pontos;           // pontuação do acusado
+    float rival;            // maior pontuação entre os outros suspeitos
+    double probabilidade;   // softmax das pontuações (compararComRivais())
+    int culpado;
+} Veredito;
+
+/*
+ avaliarAcusacao(s, suspeito, detalhar):
+ - aplica regraCondenacao ao suspeito com os pontos da sessão.
+ - rival e probabilidade só são calculados (O(pesos coletados)) quando a regra
+   os usa ou detalhar != 0; senão ficam 0 e a avaliação é O(1).
+*/
+Veredito avaliarAcusacao(const Sessao *s, IdTexto suspeito, int detalhar) {
+    const RegraCondenacao *r = &regraCondenacao;
+    Veredito v = { 0.0f, 0.0f, 0.0, 0 };
+    if (idSuspeitoMatriz(suspeito) == SUSPEITO_FORA_DA_MATRIZ) return v;
+    v.pontos = pontuacaoSuspeito(s, suspeito);
+    if (detalhar || r->margem > 0.0f || r->probabilidade > 0.0)
+        compararComRivais(s, suspeito, &v.rival, detalhar || r->probabilidade > 0.0 ? &v.probabilidade : NULL);
+    v.culpado = v.pontos >= r->minimoPontos &&
+                (r->margem <= 0.0f || v.pontos - v.rival >= r->margem) &&
+                (r->probabilidade <= 0.0 || v.probabilidade >= r->probabilidade);
+    return v;
+}
+
 // Função exigida: verificarSuspeitoFinal()
-// Verifica se existem pelo menos 2 pistas que apontam para o suspeito acusado.
+// Verifica se as pistas coletadas bastam para condenar o suspeito acusado.
 /*
  verificarSuspeitoFinal(suspeito):
- - retorna 1 se há >= 2 pistas, 0 caso contrário.
+ - retorna 1 se a acusação atende a regraCondenacao (por padrão, >= 2 pistas),
+   0 caso contrário.
  - também imprime mensagem explicativa.
 */
 int verificarSuspeitoFinal(const char *suspeito) {
     int contador = buscarContadorSuspeito(suspeito);
+    IdTexto id = procurarTexto(suspeito);
+    Veredito v = avaliarAcusacao(&sessaoJogo, id, 1);
     printf("\nVerificando acusação contra: %s\n", suspeito);
     printf("Pistas que apontam para %s: %d\n", suspeito, contador);
-    if (contador >= 2) {
+    printf("Pontuação das evidências: %.2f (mínimo %.2f) | maior entre os demais: %.2f | probabilidade: %.1f%%\n",
+           v.pontos, regraCondenacao.minimoPontos, v.rival, 100.0 * v.probabilidade);
+    if (v.culpado) {
         printf("Resultado: Há evidências suficientes. O suspeito %s é considerado CULPADO!\n", suspeito);
         return 1;
     } else {
@@ -271,55 +3682,436 @@ int verificarSuspeitoFinal(const char *suspeito) {
     }
 }
 
-// ---------------------- LIMPAR MEMÓRIA ----------------------
+// ---------------------- MODO LOTE (REPLAY) ----------------------
+
+/*
+ Modo lote: mestre --lote <arquivo|-> [--threads N] [--regra R] [mapa]
+ Entrada: uma sessão por linha,
+   <movimentos> <suspeito>
+ - movimentos: sequência de 'e'/'d'/'s' como no jogo interativo; 's' encerra
+   a exploração, portas inexistentes e caracteres desconhecidos são ignorados.
+ - suspeito: nome acusado ao final (pode conter espaços).
+ - só esquerda/direita: as portas extras do mapa não entram no modo lote.
+ Saída: uma linha por sessão, campos separados por tabulação, na ordem da entrada:
+   <sessão> <pistas novas coletadas> <suspeito> <pistas contra o suspeito> <culpado 0/1>
+ - culpado segue a regra de condenação (--regra, ver RegraCondenacao); a
+   contagem de pistas é sempre a do suspeito principal de cada pista.
+*/
+#define LOTE_SESSOES_POR_TAREFA 1024
+
+typedef struct {
+    uint32_t pistas;   // pistas novas coletadas na sessão
+    int contador;      // pistas que apontam para o acusado
+    int culpado;       // veredito de avaliarAcusacao() com regraCondenacao
+} ResultadoSessao;
+
+/*
+ jogarSessao(s, mapa, movimentos, nMov, suspeito):
+ - reinicia a sessão s e percorre o mapa compacto a partir da entrada como
+   explorarSalas(), sem imprimir nada; avalia a acusação com a mesma regra
+   de verificarSuspeitoFinal() (regraCondenacao).
+ - só lê o mapa e as associações: pode rodar em paralelo com sessões distintas.
+*/
+ResultadoSessao jogarSessao(Sessao *s, const MapaCompacto *mapa, const char *movimentos, size_t nMov, const char *suspeito) {
+    METRICA_INICIO_AMOSTRADO(inicio);
+    ResultadoSessao r = { 0, 0, 0 };
+    reiniciarSessao(s);
+
+    uint32_t atual = 0;
+    if (coletarPistaId(s, mapa->salas[atual].pista, NULL) == PISTA_NOVA) r.pistas++;
+    size_t i;
+    for (i = 0; i < nMov; i++) {
+        char c = movimentos[i];
+        if (c == 's' || c == 'S') break;
+        uint32_t prox = salaVizinhaCompacta(mapa, atual, c);
+        if (prox == MAPA_SEM_SALA) continue;
+        atual = prox;
+        if (coletarPistaId(s, mapa->salas[atual].pista, NULL) == PISTA_NOVA) r.pistas++;
+    }
 
-void liberarPistasBST(PistaNode *r) {
-    if (!r) return;
-    liberarPistasBST(r->esquerda);
-    liberarPistasBST(r->direita);
-    free(r);
+    IdTexto id = procurarTexto(suspeito);
+    r.contador = id == TEXTO_NENHUM ? 0 : buscarContadorSuspeitoId(s, id);
+    r.culpado = avaliarAcusacao(s, id, 0).culpado;
+    METRICA_SOMAR(METRICA_MOVIMENTOS_LOTE, i);
+    METRICA_SOMAR(METRICA_SESSOES_LOTE, 1);
+    METRICA_SOMAR(METRICA_PISTAS_NOVAS, r.pistas);
+    METRICA_DURACAO(METRICA_SESSAO_LOTE_NS, inicio);
+    return r;
+}
+
+// Uma linha da entrada, já separada no próprio buffer lido.
+typedef struct {
+    const char *movimentos;
+    const char *suspeito;      // terminado em '\0'
+    uint32_t nMovimentos;
+    uint32_t nSuspeito;
+} SessaoLote;
+
+// Trabalho compartilhado pelas threads: cada uma pega o próximo bloco de
+// LOTE_SESSOES_POR_TAREFA sessões ainda não jogado (balanceamento dinâmico)
+// e grava os resultados na posição de cada sessão.
+typedef struct {
+    const MapaCompacto *mapa;
+    const SessaoLote *sessoes;
+    ResultadoSessao *resultados;
+    size_t nSessoes;
+    atomic_size_t proximo;
+} TrabalhoLote;
+
+typedef struct {
+    TrabalhoLote *trabalho;
+    Sessao sessao;
+} TrabalhadorLote;
+
+static void* executarTrabalhador(void *arg) {
+    TrabalhadorLote *t = (TrabalhadorLote*) arg;
+    TrabalhoLote *w = t->trabalho;
+    while (1) {
+        size_t ini = atomic_fetch_add(&w->proximo, LOTE_SESSOES_POR_TAREFA);
+        if (ini >= w->nSessoes) break;
+        size_t fim = ini + LOTE_SESSOES_POR_TAREFA < w->nSessoes ? ini + LOTE_SESSOES_POR_TAREFA : w->nSessoes;
+        for (size_t i = ini; i < fim; i++) {
+            const SessaoLote *sl = &w->sessoes[i];
+            w->resultados[i] = jogarSessao(&t->sessao, w->mapa, sl->movimentos, sl->nMovimentos, sl->suspeito);
+        }
+    }
+    return NULL;
 }
-void liberarSalas(Sala *r) {
-    if (!r) return;
-    liberarSalas(r->esquerda);
-    liberarSalas(r->direita);
-    free(r);
+
+// Lê o arquivo inteiro para a memória (as sessões apontam para dentro dele).
+static char* lerTudo(FILE *f, size_t *tam) {
+    size_t cap = 1 << 20, n = 0;
+    char *buf = (char*) malloc(cap + 1);
+    if (!buf) { perror("malloc"); exit(1); }
+    size_t lidos;
+    while ((lidos = fread(buf + n, 1, cap - n, f)) > 0) {
+        n += lidos;
+        if (n == cap) {
+            cap *= 2;
+            buf = (char*) realloc(buf, cap + 1);
+            if (!buf) { perror("malloc"); exit(1); }
+        }
+    }
+    buf[n] = '\0';
+    *tam = n;
+    return buf;
 }
-void liberarHashPistaToSuspeito() {
-    for (int i=0;i<HASH_SIZE;i++) {
-        HashNodeStr *cur = hashPistaToSuspeito[i];
-        while (cur) {
-            HashNodeStr *aux = cur->next;
-            free(cur);
-            cur = aux;
+
+// Separa as linhas não vazias do buffer em sessões (modifica o buffer).
+static SessaoLote* separarSessoes(char *buf, size_t tam, size_t *nSessoes) {
+    size_t cap = 1024, n = 0;
+    SessaoLote *v = (SessaoLote*) malloc(cap * sizeof(SessaoLote));
+    if (!v) { perror("malloc"); exit(1); }
+    char *p = buf, *fimBuf = buf + tam;
+    while (p < fimBuf) {
+        char *fim = (char*) memchr(p, '\n', (size_t)(fimBuf - p));
+        if (!fim) fim = fimBuf;
+        char *proxLinha = fim < fimBuf ? fim + 1 : fim;
+        if (fim > p && fim[-1] == '\r') fim--;
+        *fim = '\0';
+        if (fim > p) {
+            if (n == cap) {
+                cap *= 2;
+                v = (SessaoLote*) realloc(v, cap * sizeof(SessaoLote));
+                if (!v) { perror("malloc"); exit(1); }
+            }
+            char *sep = (char*) memchr(p, ' ', (size_t)(fim - p));
+            v[n].movimentos = p;
+            v[n].nMovimentos = (uint32_t)((sep ? sep : fim) - p);
+            v[n].suspeito = sep ? sep + 1 : fim;
+            v[n].nSuspeito = (uint32_t)(fim - v[n].suspeito);
+            n++;
         }
-        hashPistaToSuspeito[i] = NULL;
+        p = proxLinha;
     }
+    *nSessoes = n;
+    return v;
 }
-void liberarHashSuspeitoCount() {
-    for (int i=0;i<HASH_SIZE;i++) {
-        HashNodeInt *cur = hashSuspeitoCount[i];
-        while (cur) {
-            HashNodeInt *aux = cur->next;
-            free(cur);
-            cur = aux;
+
+// Escreve n em decimal a partir de p e devolve o fim (sem printf: o modo lote
+// grava milhões de registros e a formatação genérica dominava o tempo).
+static char* escreverDecimal(char *p, size_t n) {
+    char tmp[24];
+    int k = 0;
+    do { tmp[k++] = (char)('0' + n % 10); n /= 10; } while (n);
+    while (k) *p++ = tmp[--k];
+    return p;
+}
+
+/*
+ executarLote(mapa, entrada, saida, nThreads):
+ - joga todas as sessões da entrada usando nThreads threads (cada uma com a
+   sua Sessao) e grava um registro por sessão em saida, na ordem da entrada.
+ - retorna o número de sessões.
+*/
+size_t executarLote(const MapaCompacto *mapa, FILE *entrada, FILE *saida, int nThreads) {
+    size_t tam, nSessoes;
+    char *buf = lerTudo(entrada, &tam);
+    SessaoLote *sessoes = separarSessoes(buf, tam, &nSessoes);
+    ResultadoSessao *resultados = (ResultadoSessao*) malloc((nSessoes ? nSessoes : 1) * sizeof(ResultadoSessao));
+    if (!resultados) { perror("malloc"); exit(1); }
+
+    if (nThreads < 1) nThreads = 1;
+    TrabalhoLote trabalho;
+    trabalho.mapa = mapa;
+    trabalho.sessoes = sessoes;
+    trabalho.resultados = resultados;
+    trabalho.nSessoes = nSessoes;
+    atomic_init(&trabalho.proximo, 0);
+
+    TrabalhadorLote *trab = (TrabalhadorLote*) malloc((size_t)nThreads * sizeof(TrabalhadorLote));
+    pthread_t *threads = (pthread_t*) malloc((size_t)nThreads * sizeof(pthread_t));
+    if (!trab || !threads) { perror("malloc"); exit(1); }
+    for (int i = 0; i < nThreads; i++) {
+        trab[i].trabalho = &trabalho;
+        iniciarSessao(&trab[i].sessao);   // na thread principal: tabelaInicializar não é thread-safe
+    }
+    for (int i = 1; i < nThreads; i++) {
+        if (pthread_create(&threads[i], NULL, executarTrabalhador, &trab[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    executarTrabalhador(&trab[0]);   // a thread principal também trabalha
+    for (int i = 1; i < nThreads; i++) pthread_join(threads[i], NULL);
+
+    char *registro = NULL;
+    size_t capRegistro = 0;
+    for (size_t i = 0; i < nSessoes; i++) {
+        const SessaoLote *sl = &sessoes[i];
+        const ResultadoSessao *r = &resultados[i];
+        if (sl->nSuspeito + 80 > capRegistro) {
+            capRegistro = sl->nSuspeito + 80;
+            registro = (char*) realloc(registro, capRegistro);
+            if (!registro) { perror("malloc"); exit(1); }
         }
-        hashSuspeitoCount[i] = NULL;
+        char *p = escreverDecimal(registro, i + 1);
+        *p++ = '\t';
+        p = escreverDecimal(p, r->pistas);
+        *p++ = '\t';
+        memcpy(p, sl->suspeito, sl->nSuspeito);
+        p += sl->nSuspeito;
+        *p++ = '\t';
+        p = escreverDecimal(p, (size_t) r->contador);
+        *p++ = '\t';
+        *p++ = r->culpado ? '1' : '0';
+        *p++ = '\n';
+        fwrite(registro, 1, (size_t)(p - registro), saida);
     }
+
+    for (int i = 0; i < nThreads; i++) liberarSessao(&trab[i].sessao);
+    free(trab); free(threads);
+    free(registro); free(resultados); free(sessoes); free(buf);
+    return nSessoes;
 }
 
-// ---------------------- FUNÇÃO MAIN ----------------------
+// ---------------------- RESUMOS DE EVIDÊNCIA POR CAMINHO ----------------------
+
+/*
+ Como só se anda para baixo na árvore, as pistas coletadas ao chegar a uma
+ sala são exatamente as do caminho raiz -> sala (sem repetição, como em
+ inserirPista()). Um percurso em profundidade sobre o mapa compacto mantém
+ os contadores do caminho atual (incrementa ao entrar, desfaz ao sair) e
+ entrega a cada sala o resumo abaixo, sem rejogar caminho algum.
+ Memória: vetores densos por IdTexto mais uma pilha proporcional à
+ profundidade; nada é guardado por sala a não ser que o chamador queira
+ (calcularResumos()).
+*/
+typedef struct {
+    IdTexto lider;          // suspeito com mais pistas no caminho (TEXTO_NENHUM se nenhum)
+    uint32_t contador;      // pistas distintas contra o líder
+    uint32_t pai;           // sala anterior no caminho ou MAPA_SEM_SALA
+    IdTexto suspeitoNovo;   // suspeito que ganhou uma pista nesta sala, ou TEXTO_NENHUM
+    uint32_t contadorNovo;  // contador desse suspeito depois desta sala
+} ResumoSala;
+
+typedef struct {
+    uint32_t sala;
+    uint32_t profundidade;
+    ResumoSala resumo;
+    char movimento;         // 'e'/'d' que levou à sala
+    char saindo;            // subárvore já empilhada: falta desfazer a sala
+} QuadroResumo;
+
+// Chamado uma vez por sala, em pré-ordem. caminho[0..profundidade) são os
+// movimentos desde a entrada e contadores[] os contadores do caminho por suspeito.
+typedef void (*VisitarResumo)(void *ctx, uint32_t sala, const ResumoSala *r,
+                              const char *caminho, uint32_t profundidade, const uint32_t *contadores);
+
+void percorrerResumos(const MapaCompacto *m, VisitarResumo visitar, void *ctx) {
+    size_t nTextos = textosInternos.quantidade ? textosInternos.quantidade : 1;
+    uint32_t *vistas = (uint32_t*) calloc(nTextos, sizeof(uint32_t));       // pista -> ocorrências no caminho
+    uint32_t *contadores = (uint32_t*) calloc(nTextos, sizeof(uint32_t));   // suspeito -> pistas no caminho
+    size_t cap = 64, topo = 0, capCaminho = 64;
+    QuadroResumo *pilha = (QuadroResumo*) malloc(cap * sizeof(QuadroResumo));
+    char *caminho = (char*) malloc(capCaminho);
+    if (!vistas || !contadores || !pilha || !caminho) { perror("malloc"); exit(1); }
 
-int main() {
-    // Inicialização das hashes para NULL
-    for (int i=0;i<HASH_SIZE;i++) {
-        hashPistaToSuspeito[i] = NULL;
-        hashSuspeitoCount[i] = NULL;
+    if (m->nSalas > 0) {
+        QuadroResumo raiz = { 0, 0, { TEXTO_NENHUM, 0, MAPA_SEM_SALA, TEXTO_NENHUM, 0 }, 0, 0 };
+        pilha[topo++] = raiz;
     }
+    while (topo) {
+        QuadroResumo *q = &pilha[topo - 1];
+        const SalaCompacta *sala = &m->salas[q->sala];
+        if (q->saindo) {
+            if (sala->pista != TEXTO_VAZIO) vistas[sala->pista]--;
+            if (q->resumo.suspeitoNovo != TEXTO_NENHUM) contadores[q->resumo.suspeitoNovo]--;
+            topo--;
+            continue;
+        }
+        q->saindo = 1;
+        ResumoSala r = q->resumo;
+        if (sala->pista != TEXTO_VAZIO && vistas[sala->pista]++ == 0) {
+            IdTexto sus = encontrarSuspeitoId(sala->pista);
+            if (sus != TEXTO_NENHUM) {
+                r.suspeitoNovo = sus;
+                r.contadorNovo = ++contadores[sus];
+                // empate mantém o líder que chegou antes ao contador
+                if (r.contadorNovo > r.contador) { r.lider = sus; r.contador = r.contadorNovo; }
+            }
+        }
+        q->resumo = r;
+        uint32_t prof = q->profundidade, atual = q->sala;
+        if (prof > 0) {
+            if (prof > capCaminho) {
+                capCaminho *= 2;
+                caminho = (char*) realloc(caminho, capCaminho);
+                if (!caminho) { perror("malloc"); exit(1); }
+            }
+            caminho[prof - 1] = q->movimento;
+        }
+        visitar(ctx, atual, &r, caminho, prof, contadores);
 
-    printf("=== DETECTIVE QUEST: JULGAMENTO FINAL ===\n");
-    printf("Explore a mansão, colete pistas e acuse quem você acha culpado.\n");
+        if (topo + 2 > cap) {
+            cap *= 2;
+            pilha = (QuadroResumo*) realloc(pilha, cap * sizeof(QuadroResumo));
+            if (!pilha) { perror("malloc"); exit(1); }
+        }
+        // direita primeiro: a esquerda sai antes da pilha
+        QuadroResumo filho = { 0, prof + 1, { r.lider, r.contador, atual, TEXTO_NENHUM, 0 }, 0, 0 };
+        if (sala->direita != MAPA_SEM_SALA) {
+            filho.sala = sala->direita; filho.movimento = 'd';
+            pilha[topo++] = filho;
+        }
+        if (sala->esquerda != MAPA_SEM_SALA) {
+            filho.sala = sala->esquerda; filho.movimento = 'e';
+            pilha[topo++] = filho;
+        }
+    }
+    free(pilha);
+    free(caminho);
+    free(vistas);
+    free(contadores);
+}
+
+static void guardarResumo(void *ctx, uint32_t sala, const ResumoSala *r,
+                          const char *caminho, uint32_t profundidade, const uint32_t *contadores) {
+    (void) caminho; (void) profundidade; (void) contadores;
+    ((ResumoSala*) ctx)[sala] = *r;
+}
+
+// Resumo de todas as salas (20 bytes por sala), indexado como m->salas.
+ResumoSala* calcularResumos(const MapaCompacto *m) {
+    ResumoSala *v = (ResumoSala*) malloc((m->nSalas ? m->nSalas : 1) * sizeof(ResumoSala));
+    if (!v) { perror("malloc"); exit(1); }
+    percorrerResumos(m, guardarResumo, v);
+    return v;
+}
+
+// Suspeito condenado por quem parar na sala (o líder, se tiver pistas
+// suficientes), ou TEXTO_NENHUM. O(1).
+IdTexto veredictoNaSala(const ResumoSala *resumos, uint32_t sala) {
+    return resumos[sala].contador >= MIN_PISTAS_CULPADO ? resumos[sala].lider : TEXTO_NENHUM;
+}
+
+// Pistas contra um suspeito qualquer ao chegar à sala: o último ancestral
+// (inclusive) em que ele ganhou pista guarda o contador. O(profundidade).
+uint32_t contadorNoCaminho(const ResumoSala *resumos, uint32_t sala, IdTexto suspeito) {
+    for (; sala != MAPA_SEM_SALA; sala = resumos[sala].pai)
+        if (resumos[sala].suspeitoNovo == suspeito) return resumos[sala].contadorNovo;
+    return 0;
+}
+
+typedef struct {
+    const MapaCompacto *mapa;
+    IdTexto suspeito;
+    uint32_t minimo;
+    FILE *saida;
+    size_t encontradas;
+} ConsultaFolhas;
+
+static void emitirFolhaCondenada(void *ctx, uint32_t sala, const ResumoSala *r,
+                                 const char *caminho, uint32_t profundidade, const uint32_t *contadores) {
+    ConsultaFolhas *c = (ConsultaFolhas*) ctx;
+    const SalaCompacta *s = &c->mapa->salas[sala];
+    (void) r;
+    if (s->esquerda != MAPA_SEM_SALA || s->direita != MAPA_SEM_SALA) return;
+    if (contadores[c->suspeito] < c->minimo) return;
+    char num[24];
+    if (profundidade) fwrite(caminho, 1, profundidade, c->saida);
+    else fputc('-', c->saida);
+    fputc('\t', c->saida);
+    fputs(textoDe(c->mapa->nomes[sala]), c->saida);
+    fputc('\t', c->saida);
+    char *fim = escreverDecimal(num, contadores[c->suspeito]);
+    *fim++ = '\n';
+    fwrite(num, 1, (size_t)(fim - num), c->saida);
+    c->encontradas++;
+}
+
+/*
+ listarFolhasCondenando(mapa, suspeito, minimo, saida):
+ - grava, para cada sala sem saídas cujo caminho desde a entrada reúne pelo
+   menos `minimo` pistas contra o suspeito, a linha
+     <movimentos>\t<sala>\t<pistas>
+   (movimentos "-" quando a própria entrada é a folha).
+ - percorre o mapa em fluxo: não guarda resumos por sala.
+ - retorna o número de folhas encontradas.
+*/
+size_t listarFolhasCondenando(const MapaCompacto *mapa, const char *suspeito, uint32_t minimo, FILE *saida) {
+    ConsultaFolhas c = { mapa, procurarTexto(suspeito), minimo, saida, 0 };
+    if (c.suspeito == TEXTO_NENHUM) return 0;
+    percorrerResumos(mapa, emitirFolhaCondenada, &c);
+    return c.encontradas;
+}
+
+// ---------------------- LIMPAR MEMÓRIA ----------------------
+
+// Salas e pistas saem das arenas: a liberação não precisa percorrer as árvores.
+void liberarPistasBST() {
+    arenaLiberar(&sessaoJogo.arena);
+    sessaoJogo.raizPistas = NULL;
+    free(sessaoJogo.coletadas);
+    free(sessaoJogo.palavrasUsadas);
+    sessaoJogo.coletadas = NULL;
+    sessaoJogo.palavrasUsadas = NULL;
+    sessaoJogo.nPalavras = sessaoJogo.nUsadas = sessaoJogo.nColetadas = 0;
+    liberarCatalogoPistas();
+}
+void liberarSalas() {
+    arenaLiberar(&arenaSalas);
+}
+void liberarHashPistaToSuspeito() {
+    tabelaLiberar(&hashPistaToSuspeito);
+    tabelaLiberar(&pesosPistaSuspeito);
+}
+void liberarHashSuspeitoCount() {
+    tabelaLiberar(&sessaoJogo.contadores);
+    free(sessaoJogo.ranking);
+    sessaoJogo.ranking = NULL;
+    sessaoJogo.nRanking = sessaoJogo.capRanking = 0;
+    free(sessaoJogo.pontos);
+    free(sessaoJogo.blocosTocados);
+    free(sessaoJogo.blocosUsados);
+    sessaoJogo.pontos = NULL;
+    sessaoJogo.blocosTocados = NULL;
+    sessaoJogo.blocosUsados = NULL;
+    sessaoJogo.nPontos = sessaoJogo.nBlocosUsados = 0;
+}
 
+// Monta a mansão padrão do jogo (mapa fixo codificado).
+Mansao montarMansaoPadrao() {
     // Montagem fixa do mapa (árvore binária de salas)
     // Cada sala tem uma pista estática definida aqui (pode ser string vazia).
     Sala *hall = criarSala("Hall de Entrada", "Pegadas de lama no tapete");
@@ -347,11 +4139,653 @@ int main() {
     inserirNaHash("Garrafa com rótulo de vinícola X", "Ana");
     inserirNaHash("Carta rasgada com assinatura S.", "Sofia");
 
-    // BST de pistas coletadas (inicialmente vazia)
+    Mansao m = { hall, NULL, 7, NULL, 0 };
+    return m;
+}
+
+// ---------------------- GERADOR DE MANSÕES ----------------------
+
+/*
+ Mansões sintéticas para medir desempenho (mestre --gerar e --benchmark).
+ Opções (todas com valor padrão):
+   --salas N            número de salas (padrão 100000)
+   --profundidade D     profundidade máxima da árvore, 0 = sem limite (padrão 0)
+   --ramificacao R      % de salas com duas saídas; as demais têm uma (padrão 50)
+   --pistas P           % de salas com pista (padrão 80)
+   --suspeitos S        número de suspeitos (padrão 8)
+   --nomes MIN:MAX      tamanho dos nomes e pistas, uniforme (padrão 8:24)
+   --ordem ordenada|aleatoria
+                        pistas distribuídas em ordem alfabética (na ordem de
+                        largura das salas) ou ao acaso (padrão aleatoria)
+   --semente X          semente do gerador (padrão 1)
+   --pesos K            associações ponderadas por pista, além do suspeito
+                        principal (padrão 0)
+   --janela W           os K suspeitos ponderados de cada pista são sorteados
+                        entre W suspeitos vizinhos em ordem alfabética, a partir
+                        de um ponto sorteado; 0 = entre todos (padrão 0)
+ A forma é montada em largura: cada sala ganha uma saída e, com chance R, a
+ segunda, até chegar a N salas ou a D níveis. R = 0 gera uma corrente e
+ R = 100 uma árvore completa. Cada pista aponta para um suspeito sorteado.
+ Com --pesos, os suspeitos são postos em ordem alfabética (a ordem dos ids
+ densos da matriz de evidências) e cada pista ganha até K pesos em (0, 1]
+ (sorteios repetidos do mesmo suspeito se fundem): W próximo de K dá linhas
+ densas na matriz e W grande, linhas esparsas.
+*/
+typedef struct {
+    size_t salas;
+    unsigned profundidade;
+    unsigned ramificacao;
+    unsigned densidade;
+    unsigned suspeitos;
+    unsigned nomeMin, nomeMax;
+    int pistasEmOrdem;
+    uint64_t semente;
+    unsigned pesos;
+    unsigned janela;
+} ParametrosGerador;
+
+// Textos e forma de uma mansão gerada, ainda fora das estruturas do jogo.
+typedef struct {
+    size_t nSalas;
+    uint32_t *esquerda;         // índices em ordem de largura (MAPA_SEM_SALA se não há)
+    uint32_t *direita;
+    unsigned profundidadeMax;   // nível da sala mais funda (a entrada é o nível 0)
+    const char **nomes;
+    const char **pistas;        // "" = sala sem pista
+    const char **suspeitoDaPista;
+    const char **suspeitos;
+    uint32_t *ponderados;       // sala i: suspeitos ponderados[i * pesos ..] (com --pesos)
+    float *pesos;
+    unsigned pesosPorPista;
+    char *texto;                // todos os textos, terminados em '\0'
+} MansaoGerada;
+
+static uint64_t proximoAleatorio(uint64_t *estado) {
+    uint64_t z = (*estado += 0x9E3779B97F4A7C15ull);   // splitmix64
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/*
+ lerParametrosGerador(argc, argv, i, p):
+ - lê as opções do gerador a partir de argv[i]; para na primeira que não
+   reconhece e retorna o índice dela.
+*/
+int lerParametrosGerador(int argc, char *argv[], int i, ParametrosGerador *p) {
+    ParametrosGerador padrao = { 100000, 0, 50, 80, 8, 8, 24, 0, 1, 0, 0 };
+    *p = padrao;
+    for (; i + 1 < argc; i += 2) {
+        const char *op = argv[i], *v = argv[i + 1];
+        if (strcmp(op, "--salas") == 0) p->salas = strtoull(v, NULL, 10);
+        else if (strcmp(op, "--profundidade") == 0) p->profundidade = (unsigned) strtoul(v, NULL, 10);
+        else if (strcmp(op, "--ramificacao") == 0) p->ramificacao = (unsigned) strtoul(v, NULL, 10);
+        else if (strcmp(op, "--pistas") == 0) p->densidade = (unsigned) strtoul(v, NULL, 10);
+        else if (strcmp(op, "--suspeitos") == 0) p->suspeitos = (unsigned) strtoul(v, NULL, 10);
+        else if (strcmp(op, "--nomes") == 0) {
+            if (sscanf(v, "%u:%u", &p->nomeMin, &p->nomeMax) != 2) p->nomeMin = p->nomeMax = 0;
+        }
+        else if (strcmp(op, "--ordem") == 0) p->pistasEmOrdem = strcmp(v, "ordenada") == 0;
+        else if (strcmp(op, "--semente") == 0) p->semente = strtoull(v, NULL, 10);
+        else if (strcmp(op, "--pesos") == 0) p->pesos = (unsigned) strtoul(v, NULL, 10);
+        else if (strcmp(op, "--janela") == 0) p->janela = (unsigned) strtoul(v, NULL, 10);
+        else break;
+    }
+    if (p->janela == 0 || p->janela > p->suspeitos) p->janela = p->suspeitos;
+    if (p->salas == 0 || p->salas >= MAPA_SEM_SALA || p->ramificacao > 100 || p->densidade > 100 ||
+        p->suspeitos == 0 || p->nomeMin == 0 || p->nomeMin > p->nomeMax || p->nomeMax >= MAX_NOME ||
+        (size_t) p->pesos * p->salas > 0xFFFFFFFFu) {
+        fprintf(stderr, "parâmetros do gerador inválidos (nomes entre 1 e %d caracteres)\n", MAX_NOME - 1);
+        exit(1);
+    }
+    return i;
+}
+
+// Escreve em dst um texto de tamanho sorteado (maiúscula seguida de minúsculas).
+static char* gerarTexto(char *dst, const ParametrosGerador *p, uint64_t *rng) {
+    size_t L = p->nomeMin + (size_t)(proximoAleatorio(rng) % (p->nomeMax - p->nomeMin + 1));
+    for (size_t i = 0; i < L; i++)
+        dst[i] = (char)((i == 0 ? 'A' : 'a') + proximoAleatorio(rng) % 26);
+    dst[L] = '\0';
+    return dst + L + 1;
+}
+
+static int compararPonteirosTexto(const void *a, const void *b) {
+    return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+// Sorteia forma, nomes, pistas e suspeitos (nada é internado ainda).
+MansaoGerada gerarTextosMansao(const ParametrosGerador *p) {
+    MansaoGerada g;
+    uint64_t rng = p->semente;
+    size_t n = p->salas;
+    unsigned *nivel = (unsigned*) malloc(n * sizeof(unsigned));
+    g.esquerda = (uint32_t*) malloc(n * sizeof(uint32_t));
+    g.direita = (uint32_t*) malloc(n * sizeof(uint32_t));
+    if (!nivel || !g.esquerda || !g.direita) { perror("malloc"); exit(1); }
+
+    size_t total = 1;
+    nivel[0] = 0;
+    g.profundidadeMax = 0;
+    for (size_t i = 0; i < total; i++) {
+        g.esquerda[i] = g.direita[i] = MAPA_SEM_SALA;
+        if (total == n || (p->profundidade && nivel[i] >= p->profundidade)) continue;
+        int duas = proximoAleatorio(&rng) % 100 < p->ramificacao;
+        int lado = (int)(proximoAleatorio(&rng) & 1);
+        for (int k = 0; k < (duas ? 2 : 1) && total < n; k++) {
+            if ((k == 0) == (lado == 0)) g.esquerda[i] = (uint32_t) total;
+            else g.direita[i] = (uint32_t) total;
+            nivel[total] = nivel[i] + 1;
+            if (nivel[total] > g.profundidadeMax) g.profundidadeMax = nivel[total];
+            total++;
+        }
+    }
+    g.nSalas = total;
+    free(nivel);
+
+    size_t nTextos = 2 * total + p->suspeitos;
+    g.texto = (char*) malloc(nTextos * (p->nomeMax + 1));
+    g.nomes = (const char**) malloc(total * sizeof(const char*));
+    g.pistas = (const char**) malloc(total * sizeof(const char*));
+    g.suspeitoDaPista = (const char**) malloc(total * sizeof(const char*));
+    g.suspeitos = (const char**) malloc(p->suspeitos * sizeof(const char*));
+    if (!g.texto || !g.nomes || !g.pistas || !g.suspeitoDaPista || !g.suspeitos) { perror("malloc"); exit(1); }
+    char *t = g.texto;
+    for (unsigned i = 0; i < p->suspeitos; i++) {
+        g.suspeitos[i] = t;
+        t = gerarTexto(t, p, &rng);
+    }
+    size_t nPistas = 0;
+    for (size_t i = 0; i < total; i++) {
+        g.nomes[i] = t;
+        t = gerarTexto(t, p, &rng);
+        if (proximoAleatorio(&rng) % 100 < p->densidade) {
+            g.pistas[nPistas++] = t;
+            t = gerarTexto(t, p, &rng);
+        }
+    }
+    if (p->pistasEmOrdem) qsort(g.pistas, nPistas, sizeof(const char*), compararPonteirosTexto);
+    // espalha as pistas pelas salas sorteadas, preservando a ordem de largura
+    size_t k = nPistas;
+    for (size_t i = total; i-- > 0; ) {
+        if (k > 0 && (size_t)(proximoAleatorio(&rng) % (i + 1)) < k) g.pistas[i] = g.pistas[--k];
+        else g.pistas[i] = "";
+    }
+    g.pesosPorPista = p->pesos;
+    g.ponderados = NULL;
+    g.pesos = NULL;
+    if (!p->pesos) {
+        for (size_t i = 0; i < total; i++)
+            g.suspeitoDaPista[i] = g.pistas[i][0] ? g.suspeitos[proximoAleatorio(&rng) % p->suspeitos] : NULL;
+    } else {
+        // suspeitos vizinhos no vetor são vizinhos na matriz de evidências; o
+        // principal também sai da janela da pista
+        qsort(g.suspeitos, p->suspeitos, sizeof(const char*), compararPonteirosTexto);
+        g.ponderados = (uint32_t*) malloc(total * p->pesos * sizeof(uint32_t));
+        g.pesos = (float*) malloc(total * p->pesos * sizeof(float));
+        if (!g.ponderados || !g.pesos) { perror("malloc"); exit(1); }
+        for (size_t i = 0; i < total; i++) {
+            g.suspeitoDaPista[i] = NULL;
+            if (!g.pistas[i][0]) continue;
+            uint32_t inicio = (uint32_t)(proximoAleatorio(&rng) % (p->suspeitos - p->janela + 1));
+            g.suspeitoDaPista[i] = g.suspeitos[inicio + proximoAleatorio(&rng) % p->janela];
+            for (unsigned k = 0; k < p->pesos; k++) {
+                g.ponderados[i * p->pesos + k] = inicio + (uint32_t)(proximoAleatorio(&rng) % p->janela);
+                g.pesos[i * p->pesos + k] = (float)((proximoAleatorio(&rng) >> 40) + 1) / (float)(1 << 24);
+            }
+        }
+    }
+    return g;
+}
+
+void liberarMansaoGerada(MansaoGerada *g) {
+    free(g->esquerda);
+    free(g->direita);
+    free(g->nomes);
+    free(g->pistas);
+    free(g->suspeitoDaPista);
+    free(g->suspeitos);
+    free(g->ponderados);
+    free(g->pesos);
+    free(g->texto);
+    memset(g, 0, sizeof(*g));
+}
+
+// Cria as salas com criarSala() e liga a árvore (sem associações).
+Mansao montarMansaoGerada(const MansaoGerada *g) {
+    Sala **salas = (Sala**) malloc(g->nSalas * sizeof(Sala*));
+    if (!salas) { perror("malloc"); exit(1); }
+    for (size_t i = 0; i < g->nSalas; i++) salas[i] = criarSala(g->nomes[i], g->pistas[i]);
+    for (size_t i = 0; i < g->nSalas; i++) {
+        salas[i]->esquerda = g->esquerda[i] == MAPA_SEM_SALA ? NULL : salas[g->esquerda[i]];
+        salas[i]->direita = g->direita[i] == MAPA_SEM_SALA ? NULL : salas[g->direita[i]];
+    }
+    Mansao m = { salas[0], NULL, g->nSalas, NULL, 0 };
+    free(salas);
+    return m;
+}
+
+void associarPistasGeradas(const MansaoGerada *g) {
+    for (size_t i = 0; i < g->nSalas; i++)
+        if (g->suspeitoDaPista[i]) inserirNaHash(g->pistas[i], g->suspeitoDaPista[i]);
+}
+
+// Associações ponderadas da mansão gerada (--pesos); retorna quantas foram feitas.
+size_t ponderarPistasGeradas(const MansaoGerada *g) {
+    size_t n = 0;
+    for (size_t i = 0; i < g->nSalas && g->pesosPorPista; i++) {
+        if (!g->suspeitoDaPista[i]) continue;
+        IdTexto pista = internarTexto(g->pistas[i]);
+        for (unsigned k = 0; k < g->pesosPorPista; k++) {
+            size_t j = i * g->pesosPorPista + k;
+            inserirAssociacaoId(pista, internarTexto(g->suspeitos[g->ponderados[j]]), g->pesos[j]);
+            n++;
+        }
+    }
+    return n;
+}
+
+// Mansão sintética completa, pronta para o jogo ou para ser gravada.
+Mansao gerarMansao(const ParametrosGerador *p) {
+    MansaoGerada g = gerarTextosMansao(p);
+    Mansao m = montarMansaoGerada(&g);
+    associarPistasGeradas(&g);
+    ponderarPistasGeradas(&g);
+    liberarMansaoGerada(&g);
+    return m;
+}
+
+// ---------------------- BENCHMARK ----------------------
+
+/*
+ mestre --benchmark [opções do gerador] [--repeticoes R]
+ Gera a mansão em memória e mede cada operação do jogo sobre ela, do zero a
+ cada rodada. Saída em TSV, uma linha por operação e rodada (as linhas que
+ começam com '#' descrevem a execução):
+   <rodada> <operação> <n> <ns por operação> <bytes> <pico de RSS em KiB>
+ - bytes: variação do heap durante a operação (negativa na liberação).
+ - pico de RSS: do processo até o fim da operação.
+*/
+typedef struct {
+    struct timespec inicio;
+    long long heapInicio;
+    FILE *saida;
+    int rodada;
+} MedicaoBenchmark;
+
+static long long bytesNoHeap(void) {
+#ifdef __GLIBC__
+    struct mallinfo2 mi = mallinfo2();
+    return (long long) mi.uordblks + (long long) mi.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static void iniciarMedicao(MedicaoBenchmark *b) {
+    b->heapInicio = bytesNoHeap();
+    clock_gettime(CLOCK_MONOTONIC, &b->inicio);
+}
+
+static void registrarMedicao(MedicaoBenchmark *b, const char *operacao, size_t n) {
+    struct timespec fim;
+    clock_gettime(CLOCK_MONOTONIC, &fim);
+    double ns = (double)(fim.tv_sec - b->inicio.tv_sec) * 1e9 + (double)(fim.tv_nsec - b->inicio.tv_nsec);
+    struct rusage uso;
+    getrusage(RUSAGE_SELF, &uso);
+    fprintf(b->saida, "%d\t%s\t%zu\t%.1f\t%lld\t%ld\n", b->rodada, operacao, n,
+            n ? ns / (double) n : ns, bytesNoHeap() - b->heapInicio, uso.ru_maxrss);
+}
+
+/*
+ executarBenchmark(p, rodadas, saida):
+ - mede, em cada rodada: construção das salas com criarSala(), inserirNaHash(),
+   encontrarSuspeito(), inserirPista() (BST com os textos, na ordem de largura),
+   incrementarContadorSuspeito(), catalogação (com a matriz de evidências),
+   atualização da pontuação por pista coletada (somarEvidencias(), também com
+   a soma escalar quando há linhas densas) e comparação com os rivais numa
+   sessão com todas as pistas, passeio completo coletando pistas, passeios da
+   entrada até uma folha (modo lote), visão ordenada e liberação de tudo.
+*/
+void executarBenchmark(const ParametrosGerador *p, int rodadas, FILE *saida) {
+    MedicaoBenchmark b;
+    b.saida = saida;
+    fprintf(saida, "# salas=%zu profundidade=%u ramificacao=%u pistas=%u suspeitos=%u nomes=%u:%u ordem=%s semente=%llu pesos=%u janela=%u\n",
+            p->salas, p->profundidade, p->ramificacao, p->densidade, p->suspeitos, p->nomeMin, p->nomeMax,
+            p->pistasEmOrdem ? "ordenada" : "aleatoria", (unsigned long long) p->semente, p->pesos, p->janela);
+    fprintf(saida, "rodada\toperacao\tn\tns_por_op\tbytes\trss_pico_kib\n");
+    for (b.rodada = 1; b.rodada <= rodadas; b.rodada++) {
+        MansaoGerada g = gerarTextosMansao(p);
+        size_t nPistas = 0;
+        for (size_t i = 0; i < g.nSalas; i++) nPistas += g.pistas[i][0] != '\0';
+        tabelaInicializar(&hashPistaToSuspeito, sizeof(IdTexto), sizeof(IdTexto));
+        tabelaInicializar(&pesosPistaSuspeito, 2 * sizeof(IdTexto), sizeof(float));
+        iniciarSessao(&sessaoJogo);
+        if (b.rodada == 1 && p->pesos) fprintf(saida, "# soma das linhas densas: %s\n", nomeSomaPesos());
+
+        iniciarMedicao(&b);
+        Mansao m = montarMansaoGerada(&g);
+        registrarMedicao(&b, "construir_salas", g.nSalas);
+
+        iniciarMedicao(&b);
+        associarPistasGeradas(&g);
+        registrarMedicao(&b, "inserir_na_hash", nPistas);
+
+        if (p->pesos) {
+            iniciarMedicao(&b);
+            size_t nPesos = ponderarPistasGeradas(&g);
+            registrarMedicao(&b, "inserir_associacao", nPesos);
+        }
+
+        iniciarMedicao(&b);
+        size_t achados = 0;
+        for (size_t i = 0; i < g.nSalas; i++)
+            if (g.pistas[i][0]) achados += encontrarSuspeito(g.pistas[i]) != NULL;
+        registrarMedicao(&b, "encontrar_suspeito", nPistas);
+        if (achados != nPistas) fprintf(saida, "# encontrar_suspeito: %zu de %zu pistas\n", achados, nPistas);
+
+        iniciarMedicao(&b);
+        PistaNode *raiz = NULL;
+        for (size_t i = 0; i < g.nSalas; i++)
+            if (g.pistas[i][0]) raiz = inserirPista(raiz, g.pistas[i], NULL);
+        registrarMedicao(&b, "inserir_pista", nPistas);
+        reiniciarSessao(&sessaoJogo);
+
+        iniciarMedicao(&b);
+        for (size_t i = 0; i < g.nSalas; i++)
+            if (g.suspeitoDaPista[i]) incrementarContadorSuspeito(g.suspeitoDaPista[i], 1);
+        registrarMedicao(&b, "incrementar_contador", nPistas);
+        reiniciarSessao(&sessaoJogo);
+
+        iniciarMedicao(&b);
+        catalogarPistas(&m);
+        registrarMedicao(&b, "catalogar_pistas", g.nSalas);
+        const MatrizEvidencias *mz = &matrizEvidencias;
+        if (b.rodada == 1)
+            fprintf(saida, "# matriz de evidências: %u suspeitos, %u linhas (%u densas), %u pesos guardados\n",
+                    mz->nSuspeitos, mz->nLinhas, mz->nDensas, mz->nLinhas ? mz->inicioLinha[mz->nLinhas] : 0);
+
+        // cada pista do mapa coletada uma vez numa sessão limpa (os pontos já alocados)
+        Sessao pontuacao;
+        iniciarSessao(&pontuacao);
+        if (mz->nLinhas) somarEvidencias(&pontuacao, 0);
+        reiniciarSessao(&pontuacao);
+        iniciarMedicao(&b);
+        for (uint32_t d = 0; d < mz->nLinhas; d++) somarEvidencias(&pontuacao, d);
+        registrarMedicao(&b, "atualizar_pontuacao", mz->nLinhas);
+        if (mz->nDensas) {
+            FuncaoSomaPesos escolhida = atomic_load(&somaPesosEscolhida);
+            atomic_store(&somaPesosEscolhida, somarPesosEscalar);
+            reiniciarSessao(&pontuacao);
+            iniciarMedicao(&b);
+            for (uint32_t d = 0; d < mz->nLinhas; d++) somarEvidencias(&pontuacao, d);
+            registrarMedicao(&b, "atualizar_pontuacao_escalar", mz->nLinhas);
+            atomic_store(&somaPesosEscolhida, escolhida);
+        }
+        size_t nComparacoes = mz->nSuspeitos < 100 ? mz->nSuspeitos : 100;
+        double somaProbabilidades = 0.0;
+        iniciarMedicao(&b);
+        for (size_t i = 0; i < nComparacoes; i++) {
+            float rival;
+            double probabilidade;
+            compararComRivais(&pontuacao, mz->suspeitos[i * mz->nSuspeitos / nComparacoes], &rival, &probabilidade);
+            somaProbabilidades += probabilidade;
+        }
+        registrarMedicao(&b, "comparar_com_rivais", nComparacoes);
+        if (somaProbabilidades > 1.0 + 1e-9)   // suspeitos distintos: a soma nunca passa de 1
+            fprintf(saida, "# comparar_com_rivais: probabilidades somam %.6f\n", somaProbabilidades);
+        liberarSessao(&pontuacao);
+
+        // passeio completo: entra em todas as salas (profundidade primeiro) coletando as pistas
+        iniciarMedicao(&b);
+        Sala **pilha = (Sala**) malloc((g.nSalas + 1) * sizeof(Sala*));
+        if (!pilha) { perror("malloc"); exit(1); }
+        size_t topo = 0, visitadas = 0;
+        pilha[topo++] = m.raiz;
+        while (topo > 0) {
+            Sala *atual = pilha[--topo];
+            coletarPista(&sessaoJogo, atual, NULL);
+            visitadas++;
+            if (atual->direita) pilha[topo++] = atual->direita;
+            if (atual->esquerda) pilha[topo++] = atual->esquerda;
+        }
+        free(pilha);
+        registrarMedicao(&b, "passeio_completo", visitadas);
+
+        iniciarMedicao(&b);
+        PistaNode *visao = pistasOrdenadas(&sessaoJogo);
+        registrarMedicao(&b, "visao_ordenada", sessaoJogo.nColetadas);
+        (void) visao;
+
+        // passeios da entrada até uma folha, como no modo lote
+        MapaCompacto mapa = compilarMapa(m.raiz);
+        // até 10000 passeios, limitados a ~10^7 movimentos no total (correntes são fundas)
+        size_t nMov = (size_t) g.profundidadeMax + 1, nPasseios = 10000000 / nMov;
+        if (nPasseios > 10000) nPasseios = 10000;
+        if (nPasseios > g.nSalas) nPasseios = g.nSalas;
+        if (nPasseios == 0) nPasseios = 1;
+        char *movimentos = (char*) malloc(nPasseios * nMov);
+        if (!movimentos) { perror("malloc"); exit(1); }
+        uint64_t rng = p->semente ^ 0x5EED;
+        for (size_t i = 0; i < nPasseios * nMov; i++) movimentos[i] = proximoAleatorio(&rng) & 1 ? 'e' : 'd';
+        Sessao sessao;
+        iniciarSessao(&sessao);
+        iniciarMedicao(&b);
+        for (size_t i = 0; i < nPasseios; i++)
+            jogarSessao(&sessao, &mapa, movimentos + i * nMov, nMov, g.suspeitos[0]);
+        registrarMedicao(&b, "passeio_raiz_folha", nPasseios);
+        liberarSessao(&sessao);
+        free(movimentos);
+        liberarMapaCompacto(&mapa);
+
+        iniciarMedicao(&b);
+        liberarSalas();
+        liberarPistasBST();
+        liberarHashPistaToSuspeito();
+        liberarHashSuspeitoCount();
+        liberarTextos();
+        registrarMedicao(&b, "liberar", g.nSalas);
+        liberarMansaoGerada(&g);
+        fflush(saida);
+    }
+}
+
+// ---------------------- FUNÇÃO MAIN ----------------------
+
+int main(int argc, char *argv[]) {
+    iniciarMetricas();   // sem efeito se compilado sem -DDQ_METRICAS
+
+    // Inicialização das hashes (vazias; crescem conforme a ocupação)
+    tabelaInicializar(&hashPistaToSuspeito, sizeof(IdTexto), sizeof(IdTexto));
+    tabelaInicializar(&pesosPistaSuspeito, 2 * sizeof(IdTexto), sizeof(float));
+    iniciarSessao(&sessaoJogo);
+
+    // Modo conversor: mestre --converter <entrada> <saida> (.dqm => binário, senão texto)
+    if (argc == 4 && strcmp(argv[1], "--converter") == 0) {
+        Mansao m = carregarMansao(argv[2]);
+        size_t L = strlen(argv[3]);
+        if (L >= 4 && strcmp(argv[3] + L - 4, ".dqm") == 0)
+            salvarMansaoBinaria(&m, argv[3]);
+        else
+            salvarMansaoTexto(&m, argv[3]);
+        free(m.bloco);
+        free(m.portas);
+        liberarSalas();
+        liberarHashPistaToSuspeito();
+        liberarTextos();
+        return 0;
+    }
+
+    // Gerador: mestre --gerar <saida> [opções do gerador] (.dqm => binário, senão texto)
+    if (argc >= 3 && strcmp(argv[1], "--gerar") == 0) {
+        ParametrosGerador p;
+        if (lerParametrosGerador(argc, argv, 3, &p) != argc) {
+            fprintf(stderr, "uso: mestre --gerar <saida> [--salas N] [--profundidade D] [--ramificacao R] [--pistas P]\n"
+                            "       [--suspeitos S] [--nomes MIN:MAX] [--ordem ordenada|aleatoria] [--semente X]\n"
+                            "       [--pesos K] [--janela W]\n");
+            return 1;
+        }
+        Mansao m = gerarMansao(&p);
+        size_t L = strlen(argv[2]);
+        if (L >= 4 && strcmp(argv[2] + L - 4, ".dqm") == 0)
+            salvarMansaoBinaria(&m, argv[2]);
+        else
+            salvarMansaoTexto(&m, argv[2]);
+        liberarSalas();
+        liberarHashPistaToSuspeito();
+        liberarTextos();
+        return 0;
+    }
+
+    // Benchmark: mestre --benchmark [opções do gerador] [--repeticoes R]
+    if (argc >= 2 && strcmp(argv[1], "--benchmark") == 0) {
+        ParametrosGerador p;
+        int rodadas = 1, i = 2;
+        while ((i = lerParametrosGerador(argc, argv, i, &p)) < argc) {
+            if (strcmp(argv[i], "--repeticoes") != 0 || i + 1 >= argc || (rodadas = atoi(argv[i + 1])) < 1) {
+                fprintf(stderr, "uso: mestre --benchmark [opções do gerador, ver --gerar] [--repeticoes R]\n");
+                return 1;
+            }
+            // as opções do gerador podem vir dos dois lados de --repeticoes
+            memmove(argv + i, argv + i + 2, (size_t)(argc - i - 2) * sizeof(char*));
+            argc -= 2;
+            i = 2;
+        }
+        liberarHashPistaToSuspeito();
+        liberarHashSuspeitoCount();
+        executarBenchmark(&p, rodadas, stdout);
+        return 0;
+    }
+
+    // Modo lote: mestre --lote <arquivo|-> [--threads N] [--regra R] [mapa]
+    if (argc >= 3 && strcmp(argv[1], "--lote") == 0) {
+        int nThreads = 1;
+        const char *arquivoMapa = NULL;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) nThreads = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--regra") == 0 && i + 1 < argc) {
+                if (!lerRegraCondenacao(argv[++i], &regraCondenacao)) {
+                    fprintf(stderr, "regra inválida: %s (esperado: pontos=P,margem=M,probabilidade=Q)\n", argv[i]);
+                    return 1;
+                }
+            }
+            else arquivoMapa = argv[i];
+        }
+        FILE *entrada = strcmp(argv[2], "-") == 0 ? stdin : fopen(argv[2], "r");
+        if (!entrada) { perror(argv[2]); return 1; }
+        Mansao m = arquivoMapa ? carregarMansao(arquivoMapa) : montarMansaoPadrao();
+        catalogarPistas(&m);
+        static char bufferSaida[1 << 16];
+        setvbuf(stdout, bufferSaida, _IOFBF, sizeof(bufferSaida));
+        MapaCompacto mapa = compilarMapa(m.raiz);
+        executarLote(&mapa, entrada, stdout, nThreads);
+        liberarMapaCompacto(&mapa);
+        if (entrada != stdin) fclose(entrada);
+        free(m.bloco);
+        free(m.portas);
+        liberarSalas();
+        liberarPistasBST();
+        liberarHashPistaToSuspeito();
+        liberarHashSuspeitoCount();
+        liberarTextos();
+        return 0;
+    }
+
+    // Consulta: mestre --condenados <suspeito> [mapa]
+    // Lista as folhas em que o suspeito acumula pistas suficientes para condenação.
+    if (argc >= 3 && strcmp(argv[1], "--condenados") == 0) {
+        Mansao m = argc > 3 ? carregarMansao(argv[3]) : montarMansaoPadrao();
+        static char bufferSaida[1 << 16];
+        setvbuf(stdout, bufferSaida, _IOFBF, sizeof(bufferSaida));
+        MapaCompacto mapa = compilarMapa(m.raiz);
+        size_t n = listarFolhasCondenando(&mapa, argv[2], MIN_PISTAS_CULPADO, stdout);
+        fflush(stdout);
+        fprintf(stderr, "%zu folha(s) condenam %s\n", n, argv[2]);
+        liberarMapaCompacto(&mapa);
+        free(m.bloco);
+        free(m.portas);
+        liberarSalas();
+        liberarHashPistaToSuspeito();
+        liberarTextos();
+        return 0;
+    }
+
+    // Consultas ao índice pista <-> suspeito:
+    //   mestre --suspeitos [mapa]                 cada suspeito com as pistas que pesam sobre ele
+    //   mestre --em-comum <s1>|<s2>|... [mapa]    pistas que pesam sobre todos os suspeitos dados
+    if ((argc >= 2 && strcmp(argv[1], "--suspeitos") == 0) || (argc >= 3 && strcmp(argv[1], "--em-comum") == 0)) {
+        int emComum = strcmp(argv[1], "--em-comum") == 0;
+        const char *arquivoMapa = argc > 2 + emComum ? argv[2 + emComum] : NULL;
+        Mansao m = arquivoMapa ? carregarMansao(arquivoMapa) : montarMansaoPadrao();
+        catalogarPistas(&m);
+        static char bufferSaida[1 << 16];
+        setvbuf(stdout, bufferSaida, _IOFBF, sizeof(bufferSaida));
+        if (emComum) {
+            size_t nSuspeitos = 0, cap = 4;
+            IdTexto *suspeitos = (IdTexto*) malloc(cap * sizeof(IdTexto));
+            if (!suspeitos) { perror("malloc"); exit(1); }
+            for (char *nome = argv[2], *fim; nome; nome = fim ? fim + 1 : NULL) {
+                fim = strchr(nome, '|');
+                if (fim) *fim = '\0';
+                if (nSuspeitos == cap) {
+                    cap *= 2;
+                    suspeitos = (IdTexto*) realloc(suspeitos, cap * sizeof(IdTexto));
+                    if (!suspeitos) { perror("malloc"); exit(1); }
+                }
+                suspeitos[nSuspeitos++] = internarTexto(nome);
+            }
+            size_t n = pistasContraTodos(suspeitos, nSuspeitos, imprimirPistaEncontrada, NULL);
+            fflush(stdout);
+            fprintf(stderr, "%zu pista(s) pesam sobre os %zu suspeito(s)\n", n, nSuspeitos);
+            free(suspeitos);
+        } else {
+            size_t n = listarSuspeitosEPistas(stdout, NULL);
+            fflush(stdout);
+            fprintf(stderr, "%zu suspeito(s), %zu associação(ões)\n", n, indiceAssociacoes.nAssociacoes);
+        }
+        free(m.bloco);
+        free(m.portas);
+        liberarSalas();
+        liberarPistasBST();
+        liberarHashPistaToSuspeito();
+        liberarTextos();
+        return 0;
+    }
+
+    // Jogo interativo: mestre [--sessao <base>] [--regra R] [mapa]
+    // Mapa: arquivo informado na linha de comando ou a mansão padrão
+    const char *arquivoMapa = NULL, *baseSessao = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sessao") == 0 && i + 1 < argc) baseSessao = argv[++i];
+        else if (strcmp(argv[i], "--regra") == 0 && i + 1 < argc) {
+            if (!lerRegraCondenacao(argv[++i], &regraCondenacao)) {
+                fprintf(stderr, "regra inválida: %s (esperado: pontos=P,margem=M,probabilidade=Q)\n", argv[i]);
+                return 1;
+            }
+        }
+        else arquivoMapa = argv[i];
+    }
+    Mansao mansao = arquivoMapa ? carregarMansao(arquivoMapa) : montarMansaoPadrao();
+    catalogarPistas(&mansao);   // ids densos das pistas para o bitset da sessão
+
+    printf("=== DETECTIVE QUEST: JULGAMENTO FINAL ===\n");
+    printf("Explore a mansão, colete pistas e acuse quem você acha culpado.\n");
+
+    // Sessão gravada (--sessao): retoma pistas e sala e passa a registrar os movimentos
+    uint32_t salaInicial = baseSessao ? ativarPersistencia(&mansao, baseSessao) : 0;
+
+    // Visão ordenada das pistas coletadas (preenchida ao fim da exploração)
     PistaNode *raizPistas = NULL;
 
-    // Exploração interativa a partir do hall
-    explorarSalas(hall, &raizPistas);
+    // Exploração interativa a partir do hall (pelo grafo quando o mapa tem portas)
+    if (mansao.nPortas > 0) {
+        GrafoMansao grafo = compilarGrafo(&mansao);
+        explorarGrafo(&grafo, salaInicial, &raizPistas);
+        liberarGrafo(&grafo);
+    } else {
+        explorarSalas(baseSessao ? persistenciaJogo.salas[salaInicial] : mansao.raiz, &raizPistas);
+    }
+    encerrarPersistencia();
 
     // Exibir lista final de pistas coletadas
     printf("\n===== PISTAS COLETADAS (ORDENADAS) =====\n");
@@ -361,9 +4795,23 @@ int main() {
         exibirPistas(raizPistas);
     }
 
+    // Suspeito mais citado pelas pistas coletadas
+    int citacoes;
+    IdTexto lider = suspeitoLider(&sessaoJogo, &citacoes);
+    if (lider != TEXTO_NENHUM)
+        printf("\nSuspeito mais citado: %s (%d pista(s))\n", textoDe(lider), citacoes);
+
+    // Cada suspeito com as pistas coletadas que pesam sobre ele
+    printf("\n===== SUSPEITOS E SUAS PISTAS =====\n");
+    if (listarSuspeitosEPistas(stdout, &sessaoJogo) == 0)
+        printf("Nenhuma pista coletada aponta para um suspeito.\n");
+
     // Solicita ao jogador indicar quem é o culpado
     char escolhaSuspeito[MAX_NOME];
-    printf("\nInforme o nome do suspeito que deseja acusar (ex: Pedro, Ana, Carlos, Sofia):\n> ");
+    if (mansao.bloco)
+        printf("\nInforme o nome do suspeito que deseja acusar:\n> ");
+    else
+        printf("\nInforme o nome do suspeito que deseja acusar (ex: Pedro, Ana, Carlos, Sofia):\n> ");
     // limpar buffer antes de fgets
     int c; while ((c=getchar()) != '\n' && c != EOF);
     if (fgets(escolhaSuspeito, sizeof(escolhaSuspeito), stdin) == NULL) {
@@ -383,10 +4831,13 @@ int main() {
     }
 
     // Limpeza de memória
-    liberarSalas(hall);
-    liberarPistasBST(raizPistas);
+    free(mansao.bloco);
+    free(mansao.portas);
+    liberarSalas();
+    liberarPistasBST();
     liberarHashPistaToSuspeito();
     liberarHashSuspeitoCount();
+    liberarTextos();
 
     printf("\nObrigado por jogar Detective Quest - Desfecho concluído.\n");
     return 0;